@@ -124,7 +124,7 @@ disk_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
+      lock_init_named (&c->lock, "disk channel");
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
  
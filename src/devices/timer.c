@@ -4,10 +4,13 @@
 #include <round.h>
 #include <stdio.h>
 #include <list.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/profile.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
   
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -25,46 +28,80 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
-static struct list sleep_list;
-
-static bool timer_less (const struct list_elem *e1, const struct list_elem *e2, void *aux UNUSED);
+/* 8254 input frequency divided by TIMER_FREQ, rounded to
+   nearest: the number of PIT counts in one timer tick. */
+#define PIT_HZ 1193180
+#define PIT_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Tickless idle.
+
+   If true, then whenever the idle thread halts the CPU, the PIT
+   is switched from periodic mode to one-shot mode, timed to
+   fire at the next tick at which there is an alarm to run.  The
+   ticks in between never interrupt the CPU.  When the CPU wakes
+   up, for the timer or any other external interrupt, the PIT
+   goes back into periodic mode and the skipped ticks are added
+   to `ticks'.
+
+   The PIT's counter is only 16 bits wide, so a single one-shot
+   can skip at most 65535 / PIT_COUNT - 1 ticks.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+static bool oneshot;            /* PIT in one-shot mode? */
+static int64_t oneshot_ticks;   /* Ticks until the one-shot fires. */
+static unsigned oneshot_count;  /* Counts programmed for the one-shot. */
+static unsigned oneshot_phase;  /* Counts since the last tick when programmed. */
+static unsigned tickless_carry; /* Sub-tick remainders of early wakeups. */
+static int64_t skipped_ticks;   /* # of ticks skipped while idle. */
+
+/* Hashed hierarchical timing wheel of pending alarms.  See
+   [Varghese87] "Hashed and Hierarchical Timing Wheels".
+
+   Level 0 has one slot per tick for the next WHEEL_SIZE ticks.
+   Each slot of level N covers WHEEL_SIZE times as many ticks as
+   a slot of level N - 1.  An alarm is hashed into the lowest
+   level whose range covers its expiration time, so insertion
+   and cancellation are O(1).  Whenever the level 0 index wraps
+   around, the current slot of level 1 is "cascaded", that is,
+   its alarms are redistributed into level 0, and so on up the
+   levels, so that each alarm moves down at most WHEEL_LEVELS - 1
+   times before it expires. */
+#define WHEEL_BITS 6                    /* Bits of tick per level. */
+#define WHEEL_SIZE (1 << WHEEL_BITS)    /* Slots per level. */
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4                  /* Number of levels. */
+#define WHEEL_SPAN ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+
+/* Next tick whose level 0 slot has not yet been run. */
+static int64_t wheel_ticks;
+
+static void wheel_insert (struct timer_alarm *);
+static void wheel_run (void);
+static int64_t wheel_next_expiry (int64_t limit);
+static void pit_program (uint8_t mode, uint16_t count);
+static uint16_t pit_read (void);
+static timer_alarm_func wake_thread;
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 
-static bool
-timer_less (const struct list_elem *e1, const struct list_elem *e2, void *aux UNUSED)
-{
-    struct thread *t1 = list_entry (e1, struct thread, elem);
-    struct thread *t2 = list_entry (e2, struct thread, elem);
-
-    ASSERT (t1 != NULL && t2 != NULL);
-/*
-    if (t1->awake_tick < t2->awake_tick)
-      return true;
-    else if (t1->awake_tick == t2->awake_tick)
-      return (t1->priority > t2->priority);
-    else
-      return false;
-*/
-    return (t1->awake_tick < t2->awake_tick);
-}
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
    corresponding interrupt. */
 void
 timer_init (void) 
 {
-  list_init (&sleep_list);
+  int level, slot;
 
-  /* 8254 input frequency divided by TIMER_FREQ, rounded to
-     nearest. */
-  uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SIZE; slot++)
+      list_init (&wheel[level][slot]);
 
-  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-  outb (0x40, count & 0xff);
-  outb (0x40, count >> 8);
+  pit_program (2, PIT_COUNT);
 
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -120,24 +157,33 @@ void
 timer_sleep (int64_t ticks) 
 {
   int64_t start = timer_ticks ();
-  struct thread *cur = thread_current ();
+  struct timer_alarm alarm;
   enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
 
   if (ticks <= 0) return;
 
-  // should we consider the case where timer_ticks () + ticks > int64_t MAX?
-  cur->awake_tick = start + ticks;
-  
+  timer_alarm_init (&alarm, wake_thread, thread_current ());
+
   old_level = intr_disable ();
-  list_insert_ordered (&sleep_list, &cur->elem, timer_less, NULL);
-  //list_push_back (&sleep_list, &cur->elem);
+  trace_event (TRACE_SLEEP, thread_tid (), ticks);
+  timer_alarm_set (&alarm, start + ticks);
   thread_block ();
-
   intr_set_level (old_level);
 }
 
+/* Alarm function for timer_sleep().  Wakes up thread T_. */
+static void
+wake_thread (void *t_) 
+{
+  struct thread *t = t_;
+
+  trace_event (TRACE_WAKE, t->tid, 0);
+  thread_unblock (t);
+  thread_preempt ();
+}
+
 /* Suspends execution for approximately MS milliseconds. */
 void
 timer_msleep (int64_t ms) 
@@ -159,56 +205,314 @@ timer_nsleep (int64_t ns)
   real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Initializes ALARM to call FUNC, passing AUX, when it
+   expires.  FUNC is called from the timer interrupt handler, so
+   it must not sleep. */
+void
+timer_alarm_init (struct timer_alarm *alarm, timer_alarm_func *func,
+                  void *aux) 
+{
+  ASSERT (alarm != NULL);
+  ASSERT (func != NULL);
+
+  alarm->func = func;
+  alarm->aux = aux;
+  alarm->pending = false;
+}
+
+/* Arms ALARM to expire when the timer reaches EXPIRES ticks.
+   If EXPIRES has already passed, ALARM expires on the next
+   timer tick.  ALARM must not already be pending.
+
+   This function may be called from an interrupt handler,
+   including from an alarm function. */
+void
+timer_alarm_set (struct timer_alarm *alarm, int64_t expires) 
+{
+  enum intr_level old_level;
+
+  ASSERT (alarm != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (!alarm->pending);
+  alarm->expires = expires;
+  alarm->pending = true;
+  wheel_insert (alarm);
+  intr_set_level (old_level);
+}
+
+/* Disarms ALARM.  Returns true if ALARM was pending, false if it
+   had already expired or was never set.
+
+   This function may be called from an interrupt handler. */
+bool
+timer_alarm_cancel (struct timer_alarm *alarm) 
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (alarm != NULL);
+
+  old_level = intr_disable ();
+  was_pending = alarm->pending;
+  if (was_pending) 
+    {
+      list_remove (&alarm->elem);
+      alarm->pending = false;
+    }
+  intr_set_level (old_level);
+
+  return was_pending;
+}
+
+/* Called by the idle thread, with interrupts off, just before
+   it halts the CPU.  In tickless mode, reprograms the PIT to
+   skip the ticks until the next one at which an alarm is due.
+
+   The one-shot is timed to fire exactly on a tick boundary, by
+   counting down what remains of the current tick plus whole
+   ticks after it.
+
+   Only a uniprocessor goes tickless: with more than one CPU,
+   another CPU could set an alarm earlier than the one-shot while
+   the bootstrap processor, which owns the PIT, sleeps. */
+void
+timer_idle_enter (void) 
+{
+  uint16_t remaining;
+  int64_t limit, deadline;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || oneshot || cpu_cnt > 1)
+    return;
+
+  remaining = pit_read ();
+  if (remaining == 0 || remaining > PIT_COUNT)
+    return;
+
+  /* Find the next tick that needs attention, no further away
+     than the PIT can count. */
+  limit = ticks + 1 + (0xffff - remaining) / PIT_COUNT;
+  deadline = wheel_next_expiry (limit);
+
+  /* The MLFQS must see the tick at each whole second. */
+  if (thread_mlfqs && deadline > ROUND_UP (ticks + 1, TIMER_FREQ))
+    deadline = ROUND_UP (ticks + 1, TIMER_FREQ);
+
+  if (deadline - ticks <= 1)
+    return;
+
+  oneshot = true;
+  oneshot_ticks = deadline - ticks;
+  oneshot_phase = PIT_COUNT - remaining;
+  oneshot_count = remaining + (oneshot_ticks - 1) * PIT_COUNT;
+  pit_program (0, oneshot_count);
+}
+
+/* Called at the start of every external interrupt.  If the PIT
+   is in one-shot mode, puts it back into periodic mode and
+   accounts for the ticks that went by while it was off.
+   TIMER_IRQ is true if the interrupt is the timer's own, in
+   which case the one-shot has fired on schedule. */
+void
+timer_idle_exit (bool timer_irq) 
+{
+  int64_t elapsed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!oneshot)
+    return;
+
+  if (timer_irq)
+    {
+      /* timer_interrupt() counts the final tick. */
+      elapsed = oneshot_ticks - 1;
+    }
+  else
+    {
+      uint16_t remaining = pit_read ();
+
+      if (remaining > oneshot_count)
+        {
+          /* The one-shot already fired and wrapped around.  Its
+             interrupt is still pending and will count the final
+             tick. */
+          elapsed = oneshot_ticks - 1;
+        }
+      else
+        {
+          /* Woken early by another device.  Restarting the
+             periodic timer now delays the tick grid by the part
+             of a tick that has already gone by, so carry that
+             part over to keep `ticks' from drifting. */
+          unsigned counts = oneshot_phase + (oneshot_count - remaining);
+          elapsed = counts / PIT_COUNT;
+          tickless_carry += counts % PIT_COUNT;
+          if (tickless_carry >= PIT_COUNT)
+            {
+              tickless_carry -= PIT_COUNT;
+              elapsed++;
+            }
+        }
+    }
+
+  pit_program (2, PIT_COUNT);
+  oneshot = false;
+  ticks += elapsed;
+  skipped_ticks += elapsed;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  if (timer_tickless)
+    printf ("Timer: %"PRId64" ticks skipped while idle\n", skipped_ticks);
 }
 
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
 {
-  struct list_elem *e;
-  struct thread *t;
-  struct thread *cur = thread_current ();
   ASSERT (intr_get_level () == INTR_OFF);
   ticks++;
+  profile_tick (args);
 
-  //list_sort (&sleep_list, timer_less, NULL);
-  for (e = list_begin (&sleep_list); e != list_end (&sleep_list);)
-  {
-    struct thread *t = list_entry (e, struct thread, elem);
-    ASSERT (t != NULL);
+  /* Charge the tick that just ended before running alarms, so
+     that a deadline thread's replenished budget is not debited
+     for time used in its previous period. */
+  thread_tick ();
+  wheel_run ();
+}
+
+/* Adds ALARM to the timing wheel. */
+static void
+wheel_insert (struct timer_alarm *alarm) 
+{
+  int64_t expires = alarm->expires;
+  int64_t delta = expires - wheel_ticks;
+  int level;
 
-    if (t->awake_tick <= ticks)
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (delta < 0)
+    {
+      /* Already expired: run it with the next slot. */
+      expires = wheel_ticks;
+      delta = 0;
+    }
+  else if (delta >= WHEEL_SPAN)
     {
-/*
- * common mistake : list_remove after thread_unblock
- *
- * - I used same elem for ready_list and sleep_list
- * - In thread_unblock, t->elem is pushed into ready_list
- * - In list_remove, t->elem which is pushed into ready_list
- *   is unlinked, which is not our intention.
- *
- * -> We should use two different list_elem (ex. elem and sleep_elem),
- *    or unlink from sleep_list before thread_unblock call.
- */
-      // ASSERT (t->status == THREAD_BLOCK);
-      e = list_remove (e);
-      thread_unblock (t);
-      /*
-      if (t->priority > cur->priority)
-        intr_yield_on_return ();
-      */
-      thread_preempt ();
+      /* Too far in the future for the wheel.  Park it in the
+         farthest slot; it is re-hashed with its real expiration
+         time when that slot is cascaded. */
+      expires = wheel_ticks + WHEEL_SPAN - 1;
+      delta = WHEEL_SPAN - 1;
     }
-    else
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (int64_t) 1 << (WHEEL_BITS * (level + 1)))
       break;
-  }
 
-  thread_tick ();
+  list_push_back (&wheel[level][(expires >> (WHEEL_BITS * level)) & WHEEL_MASK],
+                  &alarm->elem);
+}
+
+/* Moves all the alarms in LIST, which must be a timing wheel
+   slot, onto the end of DST. */
+static void
+wheel_take (struct list *dst, struct list *list) 
+{
+  if (!list_empty (list))
+    list_splice (list_end (dst), list_begin (list), list_end (list));
+}
+
+/* Runs every timing wheel slot up to and including the current
+   tick, calling the function of each expired alarm. */
+static void
+wheel_run (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (wheel_ticks <= ticks) 
+    {
+      int idx = wheel_ticks & WHEEL_MASK;
+      struct list expired;
+      int level;
+
+      /* When level 0 wraps around, cascade the current slot of
+         level 1 down, and likewise for higher levels. */
+      if (idx == 0)
+        for (level = 1; level < WHEEL_LEVELS; level++) 
+          {
+            int slot = (wheel_ticks >> (WHEEL_BITS * level)) & WHEEL_MASK;
+            struct list cascade;
+
+            list_init (&cascade);
+            wheel_take (&cascade, &wheel[level][slot]);
+            while (!list_empty (&cascade))
+              wheel_insert (list_entry (list_pop_front (&cascade),
+                                        struct timer_alarm, elem));
+            if (slot != 0)
+              break;
+          }
+
+      /* Detach the expired alarms before advancing the wheel, so
+         that alarm functions may safely re-arm their alarms. */
+      list_init (&expired);
+      wheel_take (&expired, &wheel[0][idx]);
+      wheel_ticks++;
+
+      while (!list_empty (&expired)) 
+        {
+          struct timer_alarm *alarm = list_entry (list_pop_front (&expired),
+                                                  struct timer_alarm, elem);
+          alarm->pending = false;
+          alarm->func (alarm->aux);
+        }
+    }
+}
+
+/* Returns the first tick before LIMIT at which wheel_run() has
+   work to do, or LIMIT if there is none.  A tick at which level 0
+   wraps around counts as work, because it cascades alarms from
+   the higher levels. */
+static int64_t
+wheel_next_expiry (int64_t limit) 
+{
+  int64_t t;
+
+  for (t = wheel_ticks; t < limit; t++)
+    if ((t & WHEEL_MASK) == 0 || !list_empty (&wheel[0][t & WHEEL_MASK]))
+      return t;
+  return limit;
+}
+
+/* Programs PIT counter 0 to operate in MODE, counting down from
+   COUNT.  Mode 0 interrupts once when the count reaches zero;
+   mode 2 interrupts every COUNT counts.  See [8254]. */
+static void
+pit_program (uint8_t mode, uint16_t count) 
+{
+  /* CW: counter 0, LSB then MSB, MODE, binary. */
+  outb (0x43, 0x30 | (mode << 1));
+  outb (0x40, count & 0xff);
+  outb (0x40, count >> 8);
+}
+
+/* Returns the current value of PIT counter 0. */
+static uint16_t
+pit_read (void) 
+{
+  uint8_t lsb, msb;
+
+  outb (0x43, 0x00);    /* CW: counter 0, latch count. */
+  lsb = inb (0x40);
+  msb = inb (0x40);
+  return lsb | (msb << 8);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -18,6 +20,27 @@ void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+/* An alarm, which calls a function from the timer interrupt
+   handler once the timer reaches a given tick. */
+typedef void timer_alarm_func (void *aux);
+struct timer_alarm
+  {
+    int64_t expires;            /* Tick at which to call FUNC. */
+    timer_alarm_func *func;     /* Function to call. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool pending;               /* Armed but not yet expired? */
+    struct list_elem elem;      /* Timing wheel list element. */
+  };
+
+void timer_alarm_init (struct timer_alarm *, timer_alarm_func *, void *aux);
+void timer_alarm_set (struct timer_alarm *, int64_t expires);
+bool timer_alarm_cancel (struct timer_alarm *);
+
+/* Tickless idle. */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_idle_exit (bool timer_irq);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
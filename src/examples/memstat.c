@@ -0,0 +1,47 @@
+/* memstat.c
+
+   Prints the kernel's memory usage statistics. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <syscall.h>
+
+int
+main (void) 
+{
+  static const char *pool_names[MEMSTAT_POOLS] = {"kernel", "user"};
+  struct memstat stats;
+  uint32_t i;
+
+  if (!memstat (&stats))
+    {
+      printf ("memstat: system call failed\n");
+      return EXIT_FAILURE;
+    }
+
+  for (i = 0; i < MEMSTAT_POOLS; i++)
+    {
+      const struct memstat_pool *p = &stats.pools[i];
+
+      printf ("%s pool: %"PRIu32" of %"PRIu32" pages free, "
+              "%"PRIu32" zeroed, largest free block %"PRIu32" pages\n",
+              pool_names[i], p->free_cnt, p->page_cnt, p->zeroed_cnt,
+              p->largest_free);
+      printf ("  %"PRIu64" allocations, %"PRIu64" failures, "
+              "%"PRIu64" times low\n",
+              p->allocs, p->failures, p->low_events);
+      printf ("  %"PRIu32" pages lent, %"PRIu32" pages borrowed, "
+              "%"PRIu64" reclaims\n",
+              p->lent_cnt, p->borrowed_cnt, p->reclaims);
+    }
+  for (i = 0; i < stats.class_cnt; i++)
+    {
+      const struct memstat_class *c = &stats.classes[i];
+      printf ("malloc %4"PRIu32": %4"PRIu32" arenas, %5"PRIu32" free, "
+              "%7"PRIu32" bytes in use\n",
+              c->block_size, c->arena_cnt, c->free_cnt, c->in_use);
+    }
+  printf ("malloc big: %"PRIu32" blocks, %"PRIu32" pages\n",
+          stats.big_cnt, stats.big_pages);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#ifndef __LIB_FIXED_POINT_H
+#define __LIB_FIXED_POINT_H
+
+#include <stdint.h>
+
+/* Signed 17.14 fixed-point arithmetic.
+
+   A fixed_t X represents the real number X / FIX_F: the low 14
+   bits hold the fraction, the next 17 bits the integer part, and
+   the top bit the sign.  The kernel has no floating-point
+   support, so the 4.4BSD scheduler uses these instead.
+
+   Multiplication and division of two fixed-point numbers go
+   through a 64-bit intermediate so that the product or the
+   scaled dividend does not overflow. */
+typedef int32_t fixed_t;
+
+/* Number of fraction bits. */
+#define FIX_SHIFT 14
+
+/* Fixed-point representation of 1. */
+#define FIX_F (1 << FIX_SHIFT)
+
+/* Converts integer N to fixed point. */
+static inline fixed_t
+fix_int (int n)
+{
+  return n * FIX_F;
+}
+
+/* Converts X to an integer, rounding toward zero. */
+static inline int
+fix_trunc (fixed_t x)
+{
+  return x / FIX_F;
+}
+
+/* Converts X to an integer, rounding to nearest. */
+static inline int
+fix_round (fixed_t x)
+{
+  return x >= 0 ? (x + FIX_F / 2) / FIX_F : (x - FIX_F / 2) / FIX_F;
+}
+
+/* Returns X + Y. */
+static inline fixed_t
+fix_add (fixed_t x, fixed_t y)
+{
+  return x + y;
+}
+
+/* Returns X - Y. */
+static inline fixed_t
+fix_sub (fixed_t x, fixed_t y)
+{
+  return x - y;
+}
+
+/* Returns X + N, for integer N. */
+static inline fixed_t
+fix_add_int (fixed_t x, int n)
+{
+  return x + n * FIX_F;
+}
+
+/* Returns X - N, for integer N. */
+static inline fixed_t
+fix_sub_int (fixed_t x, int n)
+{
+  return x - n * FIX_F;
+}
+
+/* Returns X * Y. */
+static inline fixed_t
+fix_mul (fixed_t x, fixed_t y)
+{
+  return (int64_t) x * y / FIX_F;
+}
+
+/* Returns X * N, for integer N. */
+static inline fixed_t
+fix_mul_int (fixed_t x, int n)
+{
+  return x * n;
+}
+
+/* Returns X / Y. */
+static inline fixed_t
+fix_div (fixed_t x, fixed_t y)
+{
+  return (int64_t) x * FIX_F / y;
+}
+
+/* Returns X / N, for integer N. */
+static inline fixed_t
+fix_div_int (fixed_t x, int n)
+{
+  return x / n;
+}
+
+#endif /* lib/fixed-point.h */
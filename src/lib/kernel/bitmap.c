@@ -21,13 +21,28 @@ typedef unsigned long elem_type;
 /* Number of bits in an element. */
 #define ELEM_BITS (sizeof (elem_type) * CHAR_BIT)
 
+/* An element with all bits set. */
+#define ELEM_ALL ((elem_type) -1)
+
 /* From the outside, a bitmap is an array of bits.  From the
    inside, it's an array of elem_type (defined above) that
-   simulates an array of bits. */
+   simulates an array of bits.
+
+   Operations on ranges of bits work a whole element at a time,
+   masking off the bits outside the range in the first and last
+   elements.
+
+   first[VALUE] is a hint for searches: no bit below it is set to
+   VALUE, although the bit at first[VALUE] need not be either.
+   Setting a bit to VALUE lowers the hint, and
+   bitmap_scan_and_flip() raises it as it finds bits of
+   !VALUE.  Like bits, the hints are not updated atomically with
+   testing bits. */
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+    size_t first[2];    /* Search hints, indexed by bit value. */
   };
 
 /* Returns the index of the element that contains the bit
@@ -68,7 +83,79 @@ last_mask (const struct bitmap *b)
   int last_bits = b->bit_cnt % ELEM_BITS;
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
+
+/* Returns a bit mask in which the bits of element ELEM_IDX that
+   represent bits START through END - 1 are set to 1 and the rest
+   are set to 0. */
+static inline elem_type
+range_mask (size_t elem_idx, size_t start, size_t end)
+{
+  elem_type mask = ELEM_ALL;
+  if (elem_idx == start / ELEM_BITS)
+    mask &= ELEM_ALL << (start % ELEM_BITS);
+  if (elem_idx == (end - 1) / ELEM_BITS && end % ELEM_BITS != 0)
+    mask &= ((elem_type) 1 << (end % ELEM_BITS)) - 1;
+  return mask;
+}
+
+/* Returns ELEM if VALUE is true and ~ELEM otherwise, so that the
+   bits of ELEM that are set to VALUE come out as 1. */
+static inline elem_type
+match (elem_type elem, bool value)
+{
+  return value ? elem : ~elem;
+}
+
+/* Returns the number of bits set to 1 in ELEM.  This is the
+   classic parallel bit count, which needs neither the POPCNT
+   instruction nor a helper function from libgcc. */
+static inline size_t
+count_ones (elem_type elem)
+{
+  elem_type x = elem;
+  x = x - ((x >> 1) & (ELEM_ALL / 3));
+  x = (x & (ELEM_ALL / 15 * 3)) + ((x >> 2) & (ELEM_ALL / 15 * 3));
+  x = (x + (x >> 4)) & (ELEM_ALL / 255 * 15);
+  return (elem_type) (x * (ELEM_ALL / 255)) >> (ELEM_BITS - CHAR_BIT);
+}
+
+/* Returns the index of the lowest bit set to 1 in ELEM, which
+   must be nonzero.  Compiles to a single BSF instruction. */
+static inline size_t
+lowest_one (elem_type elem)
+{
+  return __builtin_ctzl (elem);
+}
+
+/* Returns the index of the first bit in B between START and END,
+   exclusive, that is set to VALUE, or END if there is none. */
+static size_t
+find_next (const struct bitmap *b, size_t start, size_t end, bool value)
+{
+  size_t i;
+
+  if (start >= end)
+    return end;
+  for (i = elem_idx (start); i <= elem_idx (end - 1); i++)
+    {
+      elem_type bits = match (b->bits[i], value) & range_mask (i, start, end);
+      if (bits != 0)
+        return i * ELEM_BITS + lowest_one (bits);
+    }
+  return end;
+}
+
+/* Lowers B's search hint for VALUE to IDX, if it is higher. */
+static inline void
+lower_hint (struct bitmap *b, size_t idx, bool value)
+{
+  if (idx < b->first[value])
+    b->first[value] = idx;
+}
 
+static size_t scan (const struct bitmap *, size_t start, size_t cnt,
+                    bool value, size_t *first);
+
 /* Creation and destruction. */
 
 /* Initializes B to be a bitmap of BIT_CNT bits
@@ -82,6 +169,7 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
+      b->first[false] = b->first[true] = 0;
       b->bits = malloc (byte_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
@@ -104,6 +192,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
   ASSERT (block_size >= bitmap_buf_size (bit_cnt));
 
   b->bit_cnt = bit_cnt;
+  b->first[false] = b->first[true] = 0;
   b->bits = (elem_type *) (b + 1);
   bitmap_set_all (b, false);
   return b;
@@ -163,7 +252,8 @@ bitmap_mark (struct bitmap *b, size_t bit_idx)
   /* This is equivalent to `b->bits[idx] |= mask' except that it
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the OR instruction in [IA32-v2b]. */
-  asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  asm ("or %1, %0" : "+m" (b->bits[idx]) : "r" (mask) : "cc");
+  lower_hint (b, bit_idx, true);
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
@@ -176,7 +266,8 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
   /* This is equivalent to `b->bits[idx] &= ~mask' except that it
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the AND instruction in [IA32-v2a]. */
-  asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  asm ("and %1, %0" : "+m" (b->bits[idx]) : "r" (~mask) : "cc");
+  lower_hint (b, bit_idx, false);
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -191,7 +282,9 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
   /* This is equivalent to `b->bits[idx] ^= mask' except that it
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the XOR instruction in [IA32-v2b]. */
-  asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  asm ("xor %1, %0" : "+m" (b->bits[idx]) : "r" (mask) : "cc");
+  lower_hint (b, bit_idx, false);
+  lower_hint (b, bit_idx, true);
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -214,18 +307,35 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.  Each bit
+   is set atomically, as by bitmap_set(). */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
+  size_t end = start + cnt;
   size_t i;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  if (cnt == 0)
+    return;
+  for (i = elem_idx (start); i <= elem_idx (end - 1); i++)
+    {
+      elem_type mask = range_mask (i, start, end);
+
+      /* Storing a whole element is atomic.  Part of an element
+         takes an OR or AND instruction, as in bitmap_mark() and
+         bitmap_reset(). */
+      if (mask == ELEM_ALL)
+        b->bits[i] = value ? ELEM_ALL : 0;
+      else if (value)
+        asm ("or %1, %0" : "+m" (b->bits[i]) : "r" (mask) : "cc");
+      else
+        asm ("and %1, %0" : "+m" (b->bits[i]) : "r" (~mask) : "cc");
+    }
+  lower_hint (b, start, value);
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -233,6 +343,7 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
+  size_t end = start + cnt;
   size_t i, value_cnt;
 
   ASSERT (b != NULL);
@@ -240,9 +351,10 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (start + cnt <= b->bit_cnt);
 
   value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
+  if (cnt > 0)
+    for (i = elem_idx (start); i <= elem_idx (end - 1); i++)
+      value_cnt += count_ones (match (b->bits[i], value)
+                               & range_mask (i, start, end));
   return value_cnt;
 }
 
@@ -251,16 +363,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return find_next (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -296,18 +403,9 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  ASSERT (b != NULL);
-  ASSERT (start <= b->bit_cnt);
+  size_t first;
 
-  if (cnt <= b->bit_cnt) 
-    {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
-    }
-  return BITMAP_ERROR;
+  return scan (b, start, cnt, value, &first);
 }
 
 /* Finds the first group of CNT consecutive bits in B at or after
@@ -320,11 +418,60 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
 {
-  size_t idx = bitmap_scan (b, start, cnt, value);
+  size_t first;
+  size_t idx = scan (b, start, cnt, value, &first);
+
+  /* If the search started at the hint, then no bit below FIRST
+     is set to VALUE.  If the group found starts there, flipping
+     it moves that past the group. */
+  if (start <= b->first[value])
+    b->first[value] = first == idx && idx != BITMAP_ERROR ? idx + cnt : first;
+
   if (idx != BITMAP_ERROR) 
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
 }
+
+/* Does the work of bitmap_scan().  Also stores into *FIRST the
+   index of the first bit at or after START, or B's search hint
+   for VALUE if that is higher, that is set to VALUE, or B's size
+   if there is none.
+
+   Runs of bits set to !VALUE, including whole elements of them,
+   are skipped with find_next(), and so are runs of bits set to
+   VALUE that are too short, so the time taken is proportional to
+   the number of elements searched rather than to the number of
+   bits times CNT. */
+static size_t
+scan (const struct bitmap *b, size_t start, size_t cnt, bool value,
+      size_t *first)
+{
+  size_t orig_start = start;
+
+  ASSERT (b != NULL);
+  ASSERT (start <= b->bit_cnt);
+
+  if (start < b->first[value])
+    start = b->first[value];
+  *first = find_next (b, start, b->bit_cnt, value);
+
+  if (cnt == 0)
+    return orig_start;
+  if (cnt <= b->bit_cnt) 
+    {
+      size_t last = b->bit_cnt - cnt;
+      size_t i = *first;
+
+      while (i <= last)
+        {
+          size_t run_end = find_next (b, i, i + cnt, !value);
+          if (run_end == i + cnt)
+            return i;
+          i = find_next (b, run_end + 1, last + 1, value);
+        }
+    }
+  return BITMAP_ERROR;
+}
 
 /* File input and output. */
 
@@ -347,6 +494,7 @@ bitmap_read (struct bitmap *b, struct file *file)
       off_t size = byte_cnt (b->bit_cnt);
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+      b->first[false] = b->first[true] = 0;
     }
   return success;
 }
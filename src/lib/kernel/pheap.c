@@ -0,0 +1,193 @@
+#include "pheap.h"
+#include "../debug.h"
+
+/* Pairing heap.
+
+   See pheap.h for basic information.
+
+   The heap is a tree in which every element is no greater than
+   its children.  Each element points to its leftmost child, and
+   the children of an element form a doubly linked list through
+   `next' and `prev', except that the leftmost child's `prev'
+   points to the parent.  The root's `prev' and `next' are null.
+
+   Two trees are "linked" by making the greater root the leftmost
+   child of the lesser.  Removing the root leaves a list of
+   subtrees, which are combined by the standard two-pass method:
+   link them in pairs from left to right, then link the results
+   from right to left. */
+
+static struct pheap_elem *link (struct pheap *,
+                                struct pheap_elem *, struct pheap_elem *);
+static struct pheap_elem *combine (struct pheap *, struct pheap_elem *);
+static void cut (struct pheap_elem *);
+
+/* Initializes heap H as empty, to be ordered by LESS given
+   auxiliary data AUX. */
+void
+pheap_init (struct pheap *h, pheap_less_func *less, void *aux)
+{
+  ASSERT (h != NULL);
+  ASSERT (less != NULL);
+
+  h->root = NULL;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+pheap_empty (const struct pheap *h)
+{
+  return h->root == NULL;
+}
+
+/* Returns the minimum element of H, or a null pointer if H is
+   empty. */
+struct pheap_elem *
+pheap_min (const struct pheap *h)
+{
+  return h->root;
+}
+
+/* Inserts E into H. */
+void
+pheap_insert (struct pheap *h, struct pheap_elem *e)
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  e->child = e->next = e->prev = NULL;
+  h->root = h->root != NULL ? link (h, h->root, e) : e;
+}
+
+/* Removes the minimum element of H and returns it.  H must not
+   be empty. */
+struct pheap_elem *
+pheap_pop_min (struct pheap *h)
+{
+  struct pheap_elem *min = h->root;
+
+  ASSERT (min != NULL);
+
+  h->root = combine (h, min->child);
+  return min;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+pheap_remove (struct pheap *h, struct pheap_elem *e)
+{
+  struct pheap_elem *sub;
+
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  if (e == h->root)
+    {
+      pheap_pop_min (h);
+      return;
+    }
+
+  cut (e);
+  sub = combine (h, e->child);
+  if (sub != NULL)
+    h->root = link (h, h->root, sub);
+}
+
+/* Restores H's ordering after the value of E, which must be in
+   H, has changed. */
+void
+pheap_update (struct pheap *h, struct pheap_elem *e)
+{
+  pheap_remove (h, e);
+  pheap_insert (h, e);
+}
+
+/* Links the trees rooted at A and B, whose `next' and `prev'
+   are ignored, and returns the root of the result, whose `next'
+   and `prev' are null. */
+static struct pheap_elem *
+link (struct pheap *h, struct pheap_elem *a, struct pheap_elem *b)
+{
+  if (h->less (b, a, h->aux))
+    {
+      struct pheap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  /* Make B the leftmost child of A. */
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+
+  a->next = a->prev = NULL;
+  return a;
+}
+
+/* Combines the list of sibling trees starting at FIRST into a
+   single tree and returns its root, or a null pointer if FIRST
+   is null. */
+static struct pheap_elem *
+combine (struct pheap *h, struct pheap_elem *first)
+{
+  struct pheap_elem *pairs = NULL;
+  struct pheap_elem *root;
+
+  if (first == NULL)
+    return NULL;
+
+  /* First pass: link pairs from left to right, pushing each
+     result onto a stack threaded through `next'. */
+  while (first != NULL)
+    {
+      struct pheap_elem *a = first;
+      struct pheap_elem *b = a->next;
+      struct pheap_elem *t;
+
+      if (b == NULL)
+        {
+          first = NULL;
+          t = a;
+        }
+      else
+        {
+          first = b->next;
+          t = link (h, a, b);
+        }
+      t->next = pairs;
+      pairs = t;
+    }
+
+  /* Second pass: link the results from right to left, which is
+     the order in which they come off the stack. */
+  root = pairs;
+  pairs = pairs->next;
+  while (pairs != NULL)
+    {
+      struct pheap_elem *next = pairs->next;
+      root = link (h, root, pairs);
+      pairs = next;
+    }
+  root->next = root->prev = NULL;
+  return root;
+}
+
+/* Detaches the subtree rooted at E, which must not be the root,
+   from its parent and siblings. */
+static void
+cut (struct pheap_elem *e)
+{
+  ASSERT (e->prev != NULL);
+
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+  e->next = e->prev = NULL;
+}
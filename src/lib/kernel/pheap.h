@@ -0,0 +1,68 @@
+#ifndef __LIB_KERNEL_PHEAP_H
+#define __LIB_KERNEL_PHEAP_H
+
+/* Pairing heap.
+
+   A pairing heap is a priority queue in which finding the
+   minimum element takes O(1) time, insertion takes O(1) time,
+   and removing the minimum or an arbitrary element takes
+   O(log n) amortized time.  Changing an element's key is done by
+   removing and reinserting it.
+
+   Like lists and hash tables, the heap does not use dynamic
+   allocation.  Each structure that can be in a heap embeds a
+   struct pheap_elem member, and pheap_entry() converts a pointer
+   to the member back into a pointer to the structure.  Refer to
+   lib/kernel/list.h for a detailed explanation of the technique.
+
+   The heap is ordered by a caller-supplied "less" function, and
+   pheap_min() returns an element that no other element is less
+   than.  Among elements that compare equal, which one comes out
+   first is unspecified, so a caller that needs FIFO order must
+   break ties itself, for example with a sequence number. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct pheap_elem
+  {
+    struct pheap_elem *child;   /* Leftmost child. */
+    struct pheap_elem *next;    /* Right sibling. */
+    struct pheap_elem *prev;    /* Left sibling, or parent if leftmost. */
+  };
+
+/* Converts pointer to heap element PHEAP_ELEM into a pointer to
+   the structure that PHEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define pheap_entry(PHEAP_ELEM, STRUCT, MEMBER)                 \
+        ((STRUCT *) ((uint8_t *) &(PHEAP_ELEM)->next            \
+                     - offsetof (STRUCT, MEMBER.next)))
+
+/* Compares the values of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool pheap_less_func (const struct pheap_elem *a,
+                              const struct pheap_elem *b,
+                              void *aux);
+
+/* Pairing heap. */
+struct pheap
+  {
+    struct pheap_elem *root;    /* Minimum element, or null if empty. */
+    pheap_less_func *less;      /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void pheap_init (struct pheap *, pheap_less_func *, void *aux);
+bool pheap_empty (const struct pheap *);
+struct pheap_elem *pheap_min (const struct pheap *);
+
+void pheap_insert (struct pheap *, struct pheap_elem *);
+struct pheap_elem *pheap_pop_min (struct pheap *);
+void pheap_remove (struct pheap *, struct pheap_elem *);
+void pheap_update (struct pheap *, struct pheap_elem *);
+
+#endif /* lib/kernel/pheap.h */
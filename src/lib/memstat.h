@@ -0,0 +1,56 @@
+#ifndef __LIB_MEMSTAT_H
+#define __LIB_MEMSTAT_H
+
+#include <stdint.h>
+
+/* Memory usage statistics, as returned to user programs by the
+   memstat system call and printed by the kernel's -memstat
+   option.  Shared between the kernel and user programs. */
+
+/* Page pools, indexes into `pools' below. */
+#define MEMSTAT_KERNEL 0        /* Kernel pool. */
+#define MEMSTAT_USER 1          /* User pool. */
+#define MEMSTAT_POOLS 2
+
+/* Maximum number of malloc() size classes. */
+#define MEMSTAT_CLASSES 12
+
+/* Statistics for a page pool. */
+struct memstat_pool
+  {
+    uint32_t page_cnt;          /* Pages in the pool. */
+    uint32_t free_cnt;          /* Free pages. */
+    uint32_t zeroed_cnt;        /* Pages zeroed in advance. */
+    uint32_t largest_free;      /* Pages in largest free block. */
+    uint32_t lent_cnt;          /* Pages lent to the other pool. */
+    uint32_t borrowed_cnt;      /* Pages borrowed from the other pool. */
+    uint64_t allocs;            /* Successful allocations. */
+    uint64_t zero_allocs;       /* ...of which with PAL_ZERO. */
+    uint64_t assert_allocs;     /* ...of which with PAL_ASSERT. */
+    uint64_t failures;          /* Failed allocations. */
+    uint64_t low_events;        /* Times free pages fell below the
+                                   low watermark. */
+    uint64_t borrows;           /* Allocations from the other pool. */
+    uint64_t reclaims;          /* Times lent pages were reclaimed. */
+  };
+
+/* Statistics for a malloc() size class. */
+struct memstat_class
+  {
+    uint32_t block_size;        /* Size of each block in bytes. */
+    uint32_t arena_cnt;         /* Arenas. */
+    uint32_t free_cnt;          /* Free blocks. */
+    uint32_t in_use;            /* Bytes in blocks in use. */
+  };
+
+/* Memory usage statistics. */
+struct memstat
+  {
+    struct memstat_pool pools[MEMSTAT_POOLS];
+    uint32_t class_cnt;         /* Number of entries in `classes'. */
+    struct memstat_class classes[MEMSTAT_CLASSES];
+    uint32_t big_cnt;           /* Blocks too big for any class. */
+    uint32_t big_pages;         /* Pages in those blocks. */
+  };
+
+#endif /* lib/memstat.h */
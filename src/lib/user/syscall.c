@@ -182,3 +182,9 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+memstat (struct memstat *stats) 
+{
+  return syscall1 (SYS_MEMSTAT, stats);
+}
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <memstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +46,7 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+bool memstat (struct memstat *);
+
 #endif /* lib/user/syscall.h */
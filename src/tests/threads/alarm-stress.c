@@ -0,0 +1,90 @@
+/* Arms ALARM_CNT periodic timer alarms with short, random
+   periods, then spins for SPIN_TICKS ticks while the alarms keep
+   re-arming themselves from the timer interrupt.  Verifies that
+   every alarm fires exactly on the tick it was set for and
+   reports the longest stretch of time during which the spinning
+   thread was held off by an interrupt handler, which is the
+   worst-case interrupts-off window of the timer interrupt. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <random.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define ALARM_CNT 1024
+#define PERIOD_MAX 20
+#define SPIN_TICKS 200
+
+/* A periodic alarm. */
+struct periodic
+  {
+    struct timer_alarm alarm;   /* The alarm itself. */
+    int period;                 /* Ticks between expirations. */
+  };
+
+static timer_alarm_func periodic_func;
+
+static volatile int fire_cnt;   /* Number of expirations. */
+static volatile int late_cnt;   /* Expirations on the wrong tick. */
+
+void
+test_alarm_stress (void) 
+{
+  struct periodic *p;
+  uint64_t max_gap, prev;
+  int64_t start;
+  int i;
+
+  p = malloc (sizeof *p * ALARM_CNT);
+  ASSERT (p != NULL);
+
+  msg ("Arming %d alarms with periods of 1 to %d ticks.",
+       ALARM_CNT, PERIOD_MAX);
+  start = timer_ticks ();
+  for (i = 0; i < ALARM_CNT; i++) 
+    {
+      p[i].period = random_ulong () % PERIOD_MAX + 1;
+      timer_alarm_init (&p[i].alarm, periodic_func, &p[i]);
+      timer_alarm_set (&p[i].alarm, start + p[i].period);
+    }
+
+  /* Spin, watching for gaps in the time-stamp counter. */
+  max_gap = 0;
+  prev = rdtsc ();
+  while (timer_elapsed (start) < SPIN_TICKS) 
+    {
+      uint64_t now = rdtsc ();
+      if (now - prev > max_gap)
+        max_gap = now - prev;
+      prev = now;
+    }
+
+  for (i = 0; i < ALARM_CNT; i++)
+    if (!timer_alarm_cancel (&p[i].alarm))
+      fail ("alarm %d was not pending", i);
+  free (p);
+
+  if (fire_cnt < ALARM_CNT)
+    fail ("only %d alarms fired", fire_cnt);
+  if (late_cnt != 0)
+    fail ("%d of %d alarms fired on the wrong tick", late_cnt, fire_cnt);
+  msg ("All alarms fired on time.");
+  msg ("Max interrupts-off window: %"PRIu64" cycles.", max_gap);
+}
+
+/* Counts an expiration of periodic alarm P_ and re-arms it. */
+static void
+periodic_func (void *p_) 
+{
+  struct periodic *p = p_;
+
+  fire_cnt++;
+  if (timer_ticks () != p->alarm.expires)
+    late_cnt++;
+  timer_alarm_set (&p->alarm, p->alarm.expires + p->period);
+}
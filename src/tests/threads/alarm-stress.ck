@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+fail "Alarms did not all fire on time.\n"
+  if !grep (/^\(alarm-stress\) All alarms fired on time\.$/, @output);
+fail "No interrupts-off window reported.\n"
+  if !grep (/^\(alarm-stress\) Max interrupts-off window: \d+ cycles\.$/,
+	    @output);
+pass;
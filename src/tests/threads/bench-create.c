@@ -0,0 +1,59 @@
+/* Measures the cost of creating a thread and reaping it after it
+   exits.
+
+   In the first measurement each new thread has a higher priority
+   than the creator, so it runs and exits before the next one is
+   created.  In the second, threads are created at a lower
+   priority in batches of BATCH_CNT, and then the whole batch runs
+   and exits at once, which is more than the thread page cache
+   holds. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 2000
+#define BATCH_CNT 50
+
+static thread_func exit_func;
+
+void
+test_bench_create (void) 
+{
+  uint64_t start, cycles;
+  int i, j;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  start = rdtsc ();
+  for (i = 0; i < THREAD_CNT; i++)
+    thread_create ("child", PRI_DEFAULT + 1, exit_func, NULL);
+  cycles = rdtsc () - start;
+  msg ("one at a time: %"PRIu64" cycles per thread", cycles / THREAD_CNT);
+
+  start = rdtsc ();
+  for (i = 0; i < THREAD_CNT; i += BATCH_CNT) 
+    {
+      for (j = 0; j < BATCH_CNT; j++)
+        thread_create ("child", PRI_DEFAULT - 1, exit_func, NULL);
+
+      /* Let the batch run to completion. */
+      thread_set_priority (PRI_DEFAULT - 2);
+      thread_set_priority (PRI_DEFAULT);
+    }
+  cycles = rdtsc () - start;
+  msg ("batches of %d: %"PRIu64" cycles per thread",
+       BATCH_CNT, cycles / THREAD_CNT);
+}
+
+static void
+exit_func (void *aux UNUSED) 
+{
+}
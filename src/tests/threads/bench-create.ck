@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+fail "No measurement of single thread creation.\n"
+  if !grep (/^\(bench-create\) one at a time: \d+ cycles per thread$/,
+	    @output);
+fail "No measurement of batched thread creation.\n"
+  if !grep (/^\(bench-create\) batches of 50: \d+ cycles per thread$/,
+	    @output);
+pass;
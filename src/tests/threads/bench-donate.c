@@ -0,0 +1,111 @@
+/* Measures the cost of handing a contended lock from thread to
+   thread, with WAITER_CNT waiters of mixed priorities queued on
+   it, and checks that the waiters get the lock in order of
+   priority and, within a priority, in order of arrival.
+
+   A holder thread acquires the lock and then sleeps on a
+   semaphore.  The main thread, at minimum priority, creates the
+   waiters.  Each one runs at once, donates its priority to the
+   holder, and blocks on the lock.  Then the main thread wakes the
+   holder, which releases the lock, and the waiters acquire and
+   release it one after another before the main thread runs
+   again. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define WAITER_CNT 200
+#define PRI_CNT 30
+
+/* A waiter. */
+struct waiter
+  {
+    int priority;               /* Priority. */
+    int id;                     /* Order of arrival. */
+  };
+
+static thread_func holder_func;
+static thread_func waiter_func;
+
+static struct lock lock;
+static struct semaphore go;
+static struct waiter waiters[WAITER_CNT];
+static struct waiter *order[WAITER_CNT];
+static int order_cnt;
+
+void
+test_bench_donate (void) 
+{
+  uint64_t start, block_cycles, handoff_cycles;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  lock_init (&lock);
+  sema_init (&go, 0);
+  thread_create ("holder", PRI_DEFAULT + 1, holder_func, NULL);
+  thread_set_priority (PRI_MIN);
+
+  start = rdtsc ();
+  for (i = 0; i < WAITER_CNT; i++) 
+    {
+      struct waiter *w = &waiters[i];
+      char name[16];
+
+      w->priority = PRI_DEFAULT + 1 + i * 7 % PRI_CNT;
+      w->id = i;
+      snprintf (name, sizeof name, "waiter %d", i);
+      thread_create (name, w->priority, waiter_func, w);
+    }
+  block_cycles = rdtsc () - start;
+
+  start = rdtsc ();
+  sema_up (&go);
+  handoff_cycles = rdtsc () - start;
+  thread_set_priority (PRI_DEFAULT);
+
+  if (order_cnt != WAITER_CNT)
+    fail ("only %d of %d waiters got the lock", order_cnt, WAITER_CNT);
+  for (i = 1; i < WAITER_CNT; i++) 
+    {
+      struct waiter *a = order[i - 1];
+      struct waiter *b = order[i];
+      if (a->priority < b->priority
+          || (a->priority == b->priority && a->id > b->id))
+        fail ("waiter %d (priority %d) got the lock before "
+              "waiter %d (priority %d)",
+              a->id, a->priority, b->id, b->priority);
+    }
+  msg ("Waiters got the lock in priority order.");
+  msg ("%d waiters: %"PRIu64" cycles to create and block a waiter",
+       WAITER_CNT, block_cycles / WAITER_CNT);
+  msg ("%d waiters: %"PRIu64" cycles per handoff",
+       WAITER_CNT, handoff_cycles / WAITER_CNT);
+}
+
+static void
+holder_func (void *aux UNUSED) 
+{
+  lock_acquire (&lock);
+  sema_down (&go);
+  lock_release (&lock);
+}
+
+static void
+waiter_func (void *w_) 
+{
+  struct waiter *w = w_;
+
+  lock_acquire (&lock);
+  order[order_cnt++] = w;
+  lock_release (&lock);
+}
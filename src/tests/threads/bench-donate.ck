@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+fail "Waiters did not get the lock in priority order.\n"
+  if !grep (/^\(bench-donate\) Waiters got the lock in priority order\.$/,
+	    @output);
+foreach my $what ('to create and block a waiter', 'per handoff') {
+    fail "No measurement of cycles $what.\n"
+      if !grep (/^\(bench-donate\) 200 waiters: \d+ cycles $what$/,
+		@output);
+}
+pass;
@@ -0,0 +1,121 @@
+/* Measures the cost of a short critical section protected by
+   each kind of lock when several threads contend for it.
+
+   THREAD_CNT threads of equal priority each enter the critical
+   section ITER_CNT times.  Timer interrupts preempt them, now and
+   then in the middle of the critical section, so that the others
+   find it held.  A lock or mutex holder that is preempted makes
+   every thread that wants the lock sleep until the holder runs
+   again; a spinlock holder cannot be preempted.  The last
+   measurement does the same for malloc() and free(), whose
+   descriptor locks are spinlocks. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 4
+#define ITER_CNT 20000
+
+enum kind { LOCK, MUTEX, SPINLOCK, MALLOC };
+static const char *kind_names[] = {"lock", "mutex", "spinlock", "malloc"};
+
+static struct lock lock;
+static struct mutex mutex;
+static struct spinlock spinlock;
+static struct semaphore done;
+static volatile int counter;
+
+static thread_func worker_func;
+static void critical_section (void);
+
+void
+test_bench_lock (void) 
+{
+  enum kind kind;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  lock_init (&lock);
+  mutex_init (&mutex);
+  spin_init (&spinlock);
+  sema_init (&done, 0);
+
+  for (kind = LOCK; kind <= MALLOC; kind++) 
+    {
+      uint64_t start, cycles;
+      int i;
+
+      counter = 0;
+      start = rdtsc ();
+      for (i = 0; i < THREAD_CNT; i++)
+        thread_create (kind_names[kind], PRI_DEFAULT, worker_func, &kind);
+      for (i = 0; i < THREAD_CNT; i++)
+        sema_down (&done);
+      cycles = rdtsc () - start;
+
+      if (kind != MALLOC && counter != THREAD_CNT * ITER_CNT)
+        fail ("%s: counter is %d, expected %d",
+              kind_names[kind], counter, THREAD_CNT * ITER_CNT);
+      msg ("%s: %"PRIu64" cycles per %s", kind_names[kind],
+           cycles / (THREAD_CNT * ITER_CNT),
+           kind == MALLOC ? "malloc and free" : "critical section");
+    }
+}
+
+static void
+worker_func (void *kind_) 
+{
+  enum kind kind = *(enum kind *) kind_;
+  enum intr_level old_level;
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    switch (kind)
+      {
+      case LOCK:
+        lock_acquire (&lock);
+        critical_section ();
+        lock_release (&lock);
+        break;
+
+      case MUTEX:
+        mutex_lock (&mutex);
+        critical_section ();
+        mutex_unlock (&mutex);
+        break;
+
+      case SPINLOCK:
+        old_level = spin_lock_irqsave (&spinlock);
+        critical_section ();
+        spin_unlock_irqrestore (&spinlock, old_level);
+        break;
+
+      case MALLOC:
+        free (malloc (64));
+        break;
+      }
+  sema_up (&done);
+}
+
+/* A critical section of a few hundred cycles, about as long as
+   taking a block off a malloc() free list. */
+static void
+critical_section (void) 
+{
+  int c = counter;
+  int i;
+
+  for (i = 0; i < 32; i++)
+    barrier ();
+  counter = c + 1;
+}
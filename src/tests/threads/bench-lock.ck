@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+foreach my $kind ('lock', 'mutex', 'spinlock') {
+    fail "No measurement for $kind.\n"
+      if !grep (/^\(bench-lock\) $kind: \d+ cycles per critical section$/,
+		@output);
+}
+fail "No measurement for malloc.\n"
+  if !grep (/^\(bench-lock\) malloc: \d+ cycles per malloc and free$/,
+	    @output);
+pass;
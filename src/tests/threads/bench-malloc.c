@@ -0,0 +1,54 @@
+/* Measures how long a malloc() and free() of blocks of various
+   sizes take, the way a system call handler allocates and frees
+   a small buffer.  Each size is timed both for a single block
+   freed right away and for bursts of BURST_CNT blocks allocated
+   together and then freed together. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/malloc.h"
+
+#define ITER_CNT 1000
+#define BURST_CNT 32
+
+void
+test_bench_malloc (void) 
+{
+  static void *blocks[BURST_CNT];
+  size_t size;
+
+  for (size = 16; size <= 1024; size *= 2)
+    {
+      uint64_t single = 0, burst = 0;
+      int i, j;
+
+      for (i = 0; i < ITER_CNT; i++)
+        {
+          uint64_t start = rdtsc ();
+          void *p = malloc (size);
+          free (p);
+          single += rdtsc () - start;
+          if (p == NULL)
+            fail ("could not allocate %zu bytes", size);
+        }
+
+      for (i = 0; i < ITER_CNT / BURST_CNT; i++)
+        {
+          uint64_t start = rdtsc ();
+          for (j = 0; j < BURST_CNT; j++)
+            blocks[j] = malloc (size);
+          for (j = 0; j < BURST_CNT; j++)
+            free (blocks[j]);
+          burst += rdtsc () - start;
+          for (j = 0; j < BURST_CNT; j++)
+            if (blocks[j] == NULL)
+              fail ("could not allocate %zu bytes", size);
+        }
+
+      msg ("%zu bytes: %"PRIu64" cycles per pair, %"PRIu64" in bursts.",
+           size, single / ITER_CNT,
+           burst / (ITER_CNT / BURST_CNT * BURST_CNT));
+    }
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+for (my $size = 16; $size <= 1024; $size *= 2) {
+    fail "No measurement for $size bytes.\n"
+      if !grep (/^\(bench-malloc\) $size bytes: \d+ cycles per pair, \d+ in bursts\.$/,
+		@output);
+}
+pass;
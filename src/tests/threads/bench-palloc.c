@@ -0,0 +1,99 @@
+/* Measures how long palloc_get_multiple() takes to find runs of
+   pages of various lengths in a fragmented kernel pool.
+
+   First we take every free page in the kernel pool, one at a
+   time, chaining the pages together through their first words.
+   Then we give back the half of them that we took last, and
+   every other page of the rest, which riddles part of the pool
+   with one-page holes that longer runs cannot use.  Finally we
+   allocate and free runs of each length ITER_CNT times, timing
+   only the allocations, since freeing scrubs the pages in debug
+   builds.
+
+   bench-palloc runs with the default 4 MB of RAM, bench-palloc-64
+   with 64 MB, which is as much as the loader supports. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define ITER_CNT 1000
+
+static void bench_palloc (void);
+
+void
+test_bench_palloc (void) 
+{
+  bench_palloc ();
+}
+
+void
+test_bench_palloc_64 (void) 
+{
+  if (ram_pages < 60 * 1024 * 1024 / PGSIZE)
+    fail ("only %zu kB of RAM, expected 64 MB", ram_pages * PGSIZE / 1024);
+  bench_palloc ();
+}
+
+static void
+bench_palloc (void) 
+{
+  static const size_t run_cnts[] = {1, 2, 3, 4, 8, 16, 32};
+  void *taken = NULL, *kept = NULL;
+  void *page;
+  size_t page_cnt = 0;
+  size_t i;
+
+  /* Take every free page. */
+  while ((page = palloc_get_page (0)) != NULL)
+    {
+      *(void **) page = taken;
+      taken = page;
+      page_cnt++;
+    }
+  msg ("kernel pool: %zu free pages.", page_cnt);
+
+  /* Give back the last half, and every other page of the rest. */
+  for (i = 0; taken != NULL; i++)
+    {
+      page = taken;
+      taken = *(void **) page;
+      if (i < page_cnt / 2 || i % 2 == 0)
+        palloc_free_page (page);
+      else
+        {
+          *(void **) page = kept;
+          kept = page;
+        }
+    }
+
+  for (i = 0; i < sizeof run_cnts / sizeof *run_cnts; i++)
+    {
+      size_t run_cnt = run_cnts[i];
+      uint64_t cycles = 0;
+      int j;
+
+      for (j = 0; j < ITER_CNT; j++)
+        {
+          uint64_t start = rdtsc ();
+          void *pages = palloc_get_multiple (0, run_cnt);
+          cycles += rdtsc () - start;
+          if (pages == NULL)
+            fail ("could not allocate %zu pages", run_cnt);
+          palloc_free_multiple (pages, run_cnt);
+        }
+      msg ("%zu pages: %"PRIu64" cycles per allocation.",
+           run_cnt, cycles / ITER_CNT);
+    }
+
+  while (kept != NULL)
+    {
+      page = kept;
+      kept = *(void **) page;
+      palloc_free_page (page);
+    }
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+fail "No pool size.\n"
+  if !grep (/^\(bench-palloc\) kernel pool: \d+ free pages\.$/, @output);
+foreach my $cnt (1, 2, 3, 4, 8, 16, 32) {
+    fail "No measurement for $cnt pages.\n"
+      if !grep (/^\(bench-palloc\) $cnt pages: \d+ cycles per allocation\.$/,
+		@output);
+}
+pass;
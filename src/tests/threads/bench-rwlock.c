@@ -0,0 +1,126 @@
+/* Measures read throughput of a read-mostly structure protected
+   by a lock versus a reader-writer lock.
+
+   READER_CNT readers each look something up ITER_CNT times, and
+   one writer updates it ITER_CNT / 10 times.  Each lookup sleeps
+   for a timer tick while holding the lock, standing in for the
+   disk read of a directory scan.  With a lock, lookups happen one
+   at a time; with a reader-writer lock, they overlap, so the run
+   should take about READER_CNT times fewer ticks.
+
+   The last measurement is the cost of an uncontended read
+   acquire and release. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define READER_CNT 8
+#define ITER_CNT 20
+#define UNCONTENDED_CNT 10000
+
+static bool use_rwlock;
+static struct lock lock;
+static struct rwlock rwlock;
+static struct semaphore done;
+
+static thread_func reader_func;
+static thread_func writer_func;
+static int64_t run (bool);
+
+void
+test_bench_rwlock (void) 
+{
+  uint64_t start, cycles;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  lock_init (&lock);
+  rwlock_init (&rwlock);
+  sema_init (&done, 0);
+
+  msg ("lock: %"PRId64" ticks for %d lookups",
+       run (false), READER_CNT * ITER_CNT);
+  msg ("rwlock: %"PRId64" ticks for %d lookups",
+       run (true), READER_CNT * ITER_CNT);
+
+  start = rdtsc ();
+  for (i = 0; i < UNCONTENDED_CNT; i++) 
+    {
+      rwlock_acquire_read (&rwlock);
+      rwlock_release_read (&rwlock);
+    }
+  cycles = rdtsc () - start;
+  msg ("rwlock: %"PRIu64" cycles per uncontended read",
+       cycles / UNCONTENDED_CNT);
+}
+
+/* Runs the readers and the writer, using a reader-writer lock if
+   RW is true or a lock otherwise, and returns the number of
+   ticks it takes. */
+static int64_t
+run (bool rw) 
+{
+  int64_t start;
+  int i;
+
+  use_rwlock = rw;
+  start = timer_ticks ();
+  for (i = 0; i < READER_CNT; i++)
+    thread_create ("reader", PRI_DEFAULT, reader_func, NULL);
+  thread_create ("writer", PRI_DEFAULT, writer_func, NULL);
+  for (i = 0; i < READER_CNT + 1; i++)
+    sema_down (&done);
+  return timer_elapsed (start);
+}
+
+static void
+reader_func (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++) 
+    {
+      if (use_rwlock)
+        rwlock_acquire_read (&rwlock);
+      else
+        lock_acquire (&lock);
+      timer_sleep (1);
+      if (use_rwlock)
+        rwlock_release_read (&rwlock);
+      else
+        lock_release (&lock);
+    }
+  sema_up (&done);
+}
+
+static void
+writer_func (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT / 10; i++) 
+    {
+      if (use_rwlock)
+        rwlock_acquire_write (&rwlock);
+      else
+        lock_acquire (&lock);
+      timer_sleep (1);
+      if (use_rwlock)
+        rwlock_release_write (&rwlock);
+      else
+        lock_release (&lock);
+      timer_sleep (ITER_CNT / 4);
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+foreach my $kind ('lock', 'rwlock') {
+    fail "No measurement for $kind.\n"
+      if !grep (/^\(bench-rwlock\) $kind: \d+ ticks for 160 lookups$/,
+		@output);
+}
+fail "No measurement of uncontended reads.\n"
+  if !grep (/^\(bench-rwlock\) rwlock: \d+ cycles per uncontended read$/,
+	    @output);
+pass;
@@ -0,0 +1,77 @@
+/* Measures the cost of a thread switch as the number of ready
+   threads grows.
+
+   Two threads at PRI_DEFAULT + 1 ping-pong with thread_yield()
+   while an increasing number of filler threads at PRI_DEFAULT - 1
+   sit on the run queue without ever being chosen.  The reported
+   cost per switch should not depend on the number of fillers. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+
+#define YIELD_CNT 10000
+
+static const int filler_cnts[] = {0, 16, 64, 128};
+
+static thread_func partner_func;
+static thread_func filler_func;
+
+static volatile bool done;
+
+void
+test_bench_switch (void) 
+{
+  int filler_cnt = 0;
+  size_t i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  thread_set_priority (PRI_DEFAULT + 1);
+  thread_create ("partner", PRI_DEFAULT + 1, partner_func, NULL);
+
+  for (i = 0; i < sizeof filler_cnts / sizeof *filler_cnts; i++) 
+    {
+      uint64_t start, cycles;
+      int j;
+
+      for (; filler_cnt < filler_cnts[i]; filler_cnt++) 
+        {
+          char name[sizeof "filler " + 11];
+          snprintf (name, sizeof name, "filler %d", filler_cnt);
+          thread_create (name, PRI_DEFAULT - 1, filler_func, NULL);
+        }
+
+      start = rdtsc ();
+      for (j = 0; j < YIELD_CNT; j++)
+        thread_yield ();
+      cycles = rdtsc () - start;
+
+      msg ("%d ready threads: %"PRIu64" cycles per switch",
+           filler_cnt, cycles / (2 * YIELD_CNT));
+    }
+
+  /* Let the partner and the fillers run to completion. */
+  done = true;
+  thread_set_priority (PRI_DEFAULT - 2);
+  thread_set_priority (PRI_DEFAULT);
+}
+
+static void
+partner_func (void *aux UNUSED) 
+{
+  while (!done)
+    thread_yield ();
+}
+
+static void
+filler_func (void *aux UNUSED) 
+{
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+foreach my $cnt (0, 16, 64, 128) {
+    fail "No measurement with $cnt ready threads.\n"
+      if !grep (/^\(bench-switch\) $cnt ready threads: \d+ cycles per switch$/,
+		@output);
+}
+pass;
@@ -0,0 +1,117 @@
+/* Runs three periodic deadline threads whose total utilisation
+   is 90%, while the main thread spins at the highest normal
+   priority.  Each job uses less CPU time than its runtime, so
+   EDF must meet every deadline despite the spinning thread.
+   Also checks that admission control turns away a thread that
+   would push utilisation over 100%. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define JOB_CNT 20
+
+/* A periodic deadline thread. */
+struct task
+  {
+    int64_t runtime;            /* Ticks of CPU time per period. */
+    int64_t deadline;           /* Relative deadline. */
+    int64_t period;             /* Period. */
+    bool admitted;              /* Accepted by admission control? */
+    int misses;                 /* Deadlines missed. */
+  };
+
+static struct task tasks[] =
+  {
+    {2, 5, 10, false, 0},       /* 40%. */
+    {3, 10, 10, false, 0},      /* 30%. */
+    {4, 20, 20, false, 0},      /* 20%. */
+  };
+#define TASK_CNT (sizeof tasks / sizeof *tasks)
+
+static thread_func task_thread;
+static struct semaphore admit_sema;
+static struct semaphore done_sema;
+static volatile int done_cnt;
+
+void
+test_deadline_edf (void)
+{
+  size_t i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&admit_sema, 0);
+  sema_init (&done_sema, 0);
+  for (i = 0; i < TASK_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "task %zu", i);
+      thread_create (name, PRI_DEFAULT + 1, task_thread, &tasks[i]);
+    }
+
+  /* The tasks may start on other CPUs, so wait for each of them
+     to ask for admission. */
+  for (i = 0; i < TASK_CNT; i++)
+    sema_down (&admit_sema);
+  for (i = 0; i < TASK_CNT; i++)
+    if (!tasks[i].admitted)
+      fail ("task %zu was not admitted", i);
+  msg ("Admitted %zu deadline threads, total utilisation 90%%.", TASK_CNT);
+
+  if (thread_set_deadline (5, 10, 10))
+    fail ("admitted a thread that overcommits the deadline class");
+  msg ("Overcommitted thread rejected.");
+
+  /* Compete with the deadline threads for the CPU. */
+  thread_set_priority (PRI_MAX);
+  while (done_cnt < (int) TASK_CNT)
+    continue;
+  thread_set_priority (PRI_DEFAULT);
+
+  for (i = 0; i < TASK_CNT; i++)
+    sema_down (&done_sema);
+  for (i = 0; i < TASK_CNT; i++)
+    {
+      if (tasks[i].misses != 0)
+        fail ("task %zu missed %d of %d deadlines",
+              i, tasks[i].misses, JOB_CNT);
+      msg ("Task %zu met all %d deadlines.", i, JOB_CNT);
+    }
+}
+
+/* Runs JOB_CNT jobs of TASK_, each of which spins through one
+   tick boundary fewer than the task's runtime. */
+static void
+task_thread (void *task_)
+{
+  struct task *task = task_;
+  int job;
+
+  task->admitted = thread_set_deadline (task->runtime, task->deadline,
+                                        task->period);
+  sema_up (&admit_sema);
+  if (!task->admitted)
+    return;
+
+  for (job = 0; job < JOB_CNT; job++)
+    {
+      int64_t spin;
+      for (spin = 0; spin < task->runtime - 1; spin++)
+        {
+          int64_t start = timer_ticks ();
+          while (timer_ticks () == start)
+            continue;
+        }
+      thread_deadline_yield ();
+    }
+  task->misses = thread_get_deadline_misses ();
+  done_cnt++;
+
+  thread_set_deadline (0, 0, 0);
+  sema_up (&done_sema);
+}
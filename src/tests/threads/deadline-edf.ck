@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(deadline-edf) begin
+(deadline-edf) Admitted 3 deadline threads, total utilisation 90%.
+(deadline-edf) Overcommitted thread rejected.
+(deadline-edf) Task 0 met all 20 deadlines.
+(deadline-edf) Task 1 met all 20 deadlines.
+(deadline-edf) Task 2 met all 20 deadlines.
+(deadline-edf) end
+EOF
+pass;
@@ -0,0 +1,33 @@
+/* Checks that lock-order checking catches two locks acquired in
+   opposite orders.
+
+   The main thread acquires lock A and then lock B, which teaches
+   the checker that A comes before B.  It then acquires B and
+   then A.  No deadlock can happen, since only one thread is
+   involved, but the kernel should panic anyway, because another
+   thread taking the locks in the first order could deadlock
+   with us. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+
+void
+test_lockdep_inversion (void) 
+{
+  struct lock a, b;
+
+  lock_init (&a);
+  lock_init (&b);
+
+  msg ("acquiring a, then b.");
+  lock_acquire (&a);
+  lock_acquire (&b);
+  lock_release (&b);
+  lock_release (&a);
+
+  msg ("acquiring b, then a.");
+  lock_acquire (&b);
+  lock_acquire (&a);
+  fail ("lock order inversion not detected");
+}
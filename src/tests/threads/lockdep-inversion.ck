@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+fail "lockdep-inversion didn't start: no \"begin\" message\n"
+  if !grep (/^\(lockdep-inversion\) begin$/, @output);
+fail "lockdep-inversion failed\n"
+  if grep (/FAIL/, @output);
+fail "Inversion not reported (is NDEBUG defined?)\n"
+  if !grep (/^lockdep: lock order inversion in thread `main'\.$/, @output);
+fail "Kernel did not panic\n"
+  if !grep (/Kernel PANIC.*lock order inversion/, @output);
+pass;
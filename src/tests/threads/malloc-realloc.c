@@ -0,0 +1,99 @@
+/* Checks that realloc() keeps a block's contents as it grows
+   and shrinks through the small, multi-page-arena, and big block
+   sizes, that it resizes blocks in place when it can, and that
+   requests of 2 kB to 8 kB take less memory than whole pages
+   plus an arena header. */
+
+#include <round.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+static void fill (uint8_t *, size_t size);
+static void check (const uint8_t *, size_t size);
+
+void
+test_malloc_realloc (void) 
+{
+  static const size_t sizes[] = {10, 100, 1000, 2000, 3000, 4096, 6000,
+                                 8192, 20000, 50000, 9000, 3000, 10};
+  static const size_t large[] = {2048, 3000, 4096, 6000, 8192};
+  uint8_t *p;
+  uintptr_t addr;
+  size_t old_size;
+  size_t i;
+
+  /* Grow and shrink a block, checking its contents each time. */
+  p = NULL;
+  old_size = 0;
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      size_t size = sizes[i];
+
+      p = realloc (p, size);
+      if (p == NULL)
+        fail ("realloc to %zu bytes failed", size);
+      check (p, size < old_size ? size : old_size);
+      fill (p, size);
+      old_size = size;
+    }
+  free (p);
+  msg ("Contents kept across reallocation.");
+
+  /* Resizing within a size class does not move a block.  We
+     compare addresses as integers, since the old pointer is
+     indeterminate after realloc(). */
+  p = malloc (100);
+  addr = (uintptr_t) p;
+  p = realloc (p, 120);
+  if ((uintptr_t) p != addr || (uintptr_t) (p = realloc (p, 70)) != addr)
+    fail ("block moved within its size class");
+  free (p);
+
+  /* A big block grows in place into the free pages after it.
+     Five pages come from an eight-page buddy block, whose last
+     three pages are then free. */
+  p = malloc (5 * PGSIZE - 100);
+  addr = (uintptr_t) p;
+  fill (p, 5 * PGSIZE - 100);
+  p = realloc (p, 7 * PGSIZE - 100);
+  if ((uintptr_t) p != addr)
+    fail ("big block moved while growing into free pages");
+  check (p, 5 * PGSIZE - 100);
+  p = realloc (p, 6 * PGSIZE - 100);
+  if ((uintptr_t) p != addr)
+    fail ("big block moved while shrinking");
+  free (p);
+  msg ("Blocks resized in place.");
+
+  /* A block on pages of its own would take whole pages for the
+     block plus at least a byte of header. */
+  for (i = 0; i < sizeof large / sizeof *large; i++)
+    if (malloc_footprint (large[i]) >= ROUND_UP (large[i] + 1, PGSIZE))
+      fail ("%zu-byte block takes %zu bytes", large[i],
+            malloc_footprint (large[i]));
+  msg ("Large blocks take less than whole pages.");
+}
+
+/* Fills the SIZE bytes at P with a pattern. */
+static void
+fill (uint8_t *p, size_t size) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    p[i] = i % 251;
+}
+
+/* Checks that the SIZE bytes at P hold the pattern from fill(). */
+static void
+check (const uint8_t *p, size_t size) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != i % 251)
+      fail ("byte %zu of block changed", i);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-realloc) begin
+(malloc-realloc) Contents kept across reallocation.
+(malloc-realloc) Blocks resized in place.
+(malloc-realloc) Large blocks take less than whole pages.
+(malloc-realloc) end
+EOF
+pass;
@@ -0,0 +1,59 @@
+/* Takes every page that can be had from the kernel pool and
+   checks that, once the kernel pool is used up, it borrows pages
+   from the user pool, that the user pool keeps some pages for
+   itself, and that freeing the pages returns the borrowed ones
+   to the user pool. */
+
+#include <inttypes.h>
+#include <memstat.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+
+void
+test_palloc_borrow (void) 
+{
+  struct memstat_pool before[MEMSTAT_POOLS], after[MEMSTAT_POOLS];
+  void *taken = NULL;
+  void *page;
+  size_t page_cnt = 0;
+
+  palloc_get_stats (before);
+
+  /* Take every page, chaining them through their first words. */
+  while ((page = palloc_get_page (0)) != NULL)
+    {
+      *(void **) page = taken;
+      taken = page;
+      page_cnt++;
+    }
+
+  palloc_get_stats (after);
+  if (page_cnt <= before[MEMSTAT_KERNEL].free_cnt)
+    fail ("took only %zu pages, but kernel pool had %"PRIu32" free",
+          page_cnt, before[MEMSTAT_KERNEL].free_cnt);
+  if (after[MEMSTAT_KERNEL].borrowed_cnt == 0
+      || after[MEMSTAT_KERNEL].borrows <= before[MEMSTAT_KERNEL].borrows)
+    fail ("kernel pool did not borrow");
+  if (after[MEMSTAT_USER].lent_cnt != after[MEMSTAT_KERNEL].borrowed_cnt)
+    fail ("user pool lent %"PRIu32" pages, kernel pool borrowed %"PRIu32,
+          after[MEMSTAT_USER].lent_cnt, after[MEMSTAT_KERNEL].borrowed_cnt);
+  msg ("Kernel pool borrowed from user pool.");
+
+  if (after[MEMSTAT_USER].free_cnt == 0)
+    fail ("user pool lent all of its pages");
+  msg ("User pool kept a reserve.");
+
+  while (taken != NULL)
+    {
+      page = taken;
+      taken = *(void **) page;
+      palloc_free_page (page);
+    }
+
+  palloc_get_stats (after);
+  if (after[MEMSTAT_USER].lent_cnt != before[MEMSTAT_USER].lent_cnt)
+    fail ("%"PRIu32" pages still lent after freeing",
+          after[MEMSTAT_USER].lent_cnt);
+  msg ("Borrowed pages returned.");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-borrow) begin
+(palloc-borrow) Kernel pool borrowed from user pool.
+(palloc-borrow) User pool kept a reserve.
+(palloc-borrow) Borrowed pages returned.
+(palloc-borrow) end
+EOF
+pass;
@@ -0,0 +1,77 @@
+/* Low-priority main thread L acquires a lock.  Medium-priority
+   thread M acquires a reader-writer lock for reading, then blocks
+   acquiring L's lock.  High-priority thread H then blocks
+   acquiring the reader-writer lock for writing.  Thus, H donates
+   its priority to reader M, which in turn donates it to L. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct locks 
+  {
+    struct lock lock;
+    struct rwlock rwlock;
+  };
+
+static thread_func medium_thread_func;
+static thread_func high_thread_func;
+
+void
+test_priority_donate_rwlock_chain (void) 
+{
+  struct locks locks;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  lock_init (&locks.lock);
+  rwlock_init (&locks.rwlock);
+  lock_acquire (&locks.lock);
+
+  thread_create ("medium", PRI_DEFAULT + 1, medium_thread_func, &locks);
+  msg ("Low thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+
+  thread_create ("high", PRI_DEFAULT + 5, high_thread_func, &locks);
+  msg ("Low thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+
+  lock_release (&locks.lock);
+  msg ("Low thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+  msg ("High and medium threads should have finished, in that order.");
+}
+
+static void
+medium_thread_func (void *locks_) 
+{
+  struct locks *locks = locks_;
+
+  rwlock_acquire_read (&locks->rwlock);
+  msg ("Medium thread got the read lock.");
+  lock_acquire (&locks->lock);
+  msg ("Medium thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+  lock_release (&locks->lock);
+  rwlock_release_read (&locks->rwlock);
+  msg ("Medium thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+  msg ("Medium thread finished.");
+}
+
+static void
+high_thread_func (void *locks_) 
+{
+  struct locks *locks = locks_;
+
+  rwlock_acquire_write (&locks->rwlock);
+  msg ("High thread got the write lock.");
+  rwlock_release_write (&locks->rwlock);
+  msg ("High thread finished.");
+}
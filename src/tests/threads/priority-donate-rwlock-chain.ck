@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-rwlock-chain) begin
+(priority-donate-rwlock-chain) Medium thread got the read lock.
+(priority-donate-rwlock-chain) Low thread should have priority 32.  Actual priority: 32.
+(priority-donate-rwlock-chain) Low thread should have priority 36.  Actual priority: 36.
+(priority-donate-rwlock-chain) Medium thread should have priority 36.  Actual priority: 36.
+(priority-donate-rwlock-chain) High thread got the write lock.
+(priority-donate-rwlock-chain) High thread finished.
+(priority-donate-rwlock-chain) Medium thread should have priority 32.  Actual priority: 32.
+(priority-donate-rwlock-chain) Medium thread finished.
+(priority-donate-rwlock-chain) Low thread should have priority 31.  Actual priority: 31.
+(priority-donate-rwlock-chain) High and medium threads should have finished, in that order.
+(priority-donate-rwlock-chain) end
+EOF
+pass;
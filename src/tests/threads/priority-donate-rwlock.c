@@ -0,0 +1,73 @@
+/* The main thread acquires a reader-writer lock for reading, and
+   so does a higher-priority reader thread, which then blocks on
+   a semaphore.  A still higher-priority writer then blocks
+   acquiring the lock for writing, which should donate its
+   priority to both readers.  Each reader should lose the
+   donation when it releases its read lock, and the writer should
+   get the lock only when both have. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct rwlock_test 
+  {
+    struct rwlock rwlock;
+    struct semaphore wait;
+  };
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_priority_donate_rwlock (void) 
+{
+  struct rwlock_test t;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&t.rwlock);
+  sema_init (&t.wait, 0);
+  rwlock_acquire_read (&t.rwlock);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, &t);
+  thread_create ("writer", PRI_DEFAULT + 5, writer_thread_func, &t);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+  rwlock_release_read (&t.rwlock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+  sema_up (&t.wait);
+  msg ("writer, reader must already have finished, in that order.");
+}
+
+static void
+reader_thread_func (void *t_) 
+{
+  struct rwlock_test *t = t_;
+
+  rwlock_acquire_read (&t->rwlock);
+  msg ("reader: got the read lock.");
+  sema_down (&t->wait);
+  msg ("reader: should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+  rwlock_release_read (&t->rwlock);
+  msg ("reader: should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+}
+
+static void
+writer_thread_func (void *t_) 
+{
+  struct rwlock_test *t = t_;
+
+  rwlock_acquire_write (&t->rwlock);
+  msg ("writer: got the write lock.");
+  rwlock_release_write (&t->rwlock);
+  msg ("writer: done.");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-rwlock) begin
+(priority-donate-rwlock) reader: got the read lock.
+(priority-donate-rwlock) This thread should have priority 36.  Actual priority: 36.
+(priority-donate-rwlock) This thread should have priority 31.  Actual priority: 31.
+(priority-donate-rwlock) reader: should have priority 36.  Actual priority: 36.
+(priority-donate-rwlock) writer: got the write lock.
+(priority-donate-rwlock) writer: done.
+(priority-donate-rwlock) reader: should have priority 32.  Actual priority: 32.
+(priority-donate-rwlock) writer, reader must already have finished, in that order.
+(priority-donate-rwlock) end
+EOF
+pass;
@@ -0,0 +1,65 @@
+/* Checks that a waiting writer keeps new readers out of a
+   reader-writer lock, and that downgrading a write lock lets
+   waiting readers in.
+
+   The main thread acquires the lock for writing.  Reader A,
+   writer B, and reader C, all of equal priority, then block on
+   the lock in that order.  When the main thread downgrades its
+   hold, A gets in alongside it.  B must wait for both readers to
+   leave, donating its priority to the main thread meanwhile, and
+   C must wait for B even though the lock is only held for
+   reading when C could otherwise get in. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_writer_pref (void) 
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock);
+  rwlock_acquire_write (&rwlock);
+  thread_create ("reader A", PRI_DEFAULT + 1, reader_thread_func, &rwlock);
+  thread_create ("writer B", PRI_DEFAULT + 1, writer_thread_func, &rwlock);
+  thread_create ("reader C", PRI_DEFAULT + 1, reader_thread_func, &rwlock);
+
+  msg ("main: downgrading.");
+  rwlock_downgrade (&rwlock);
+  msg ("main: should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+  rwlock_release_read (&rwlock);
+  msg ("main: done.");
+}
+
+static void
+reader_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_read (rwlock);
+  msg ("%s: got the read lock.", thread_name ());
+  rwlock_release_read (rwlock);
+}
+
+static void
+writer_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_write (rwlock);
+  msg ("%s: got the write lock.", thread_name ());
+  rwlock_release_write (rwlock);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer-pref) begin
+(rwlock-writer-pref) main: downgrading.
+(rwlock-writer-pref) reader A: got the read lock.
+(rwlock-writer-pref) main: should have priority 32.  Actual priority: 32.
+(rwlock-writer-pref) writer B: got the write lock.
+(rwlock-writer-pref) reader C: got the read lock.
+(rwlock-writer-pref) main: done.
+(rwlock-writer-pref) end
+EOF
+pass;
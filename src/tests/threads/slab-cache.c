@@ -0,0 +1,87 @@
+/* Allocates and frees objects from an object cache with a
+   constructor and checks that each object is constructed exactly
+   once, that objects keep their constructed state across reuse,
+   that they are properly aligned, and that the cache grows past
+   a single slab. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/threads/tests.h"
+#include "threads/slab.h"
+
+#define OBJ_CNT 100
+#define ALIGN 64
+
+/* Object with constructed state. */
+struct obj
+  {
+    unsigned magic;             /* Set by the constructor. */
+    int ctor_cnt;               /* Times the constructor ran. */
+    int use_cnt;                /* Times the object was allocated. */
+  };
+
+#define OBJ_MAGIC 0x0b1ec7ed
+
+static kmem_ctor_func obj_ctor;
+static int total_ctor_cnt;
+
+void
+test_slab_cache (void) 
+{
+  static struct obj *objs[OBJ_CNT];
+  struct kmem_cache *cache;
+  int i;
+
+  cache = kmem_cache_create ("slab-cache test", sizeof (struct obj),
+                             ALIGN, obj_ctor);
+  if (cache == NULL)
+    fail ("kmem_cache_create() failed");
+
+  /* Allocate more objects than fit in a page. */
+  for (i = 0; i < OBJ_CNT; i++) 
+    {
+      struct obj *o = objs[i] = kmem_cache_alloc (cache);
+      if (o == NULL)
+        fail ("allocation %d failed", i);
+      if ((uintptr_t) o % ALIGN != 0)
+        fail ("object %p is not aligned on a %d-byte boundary", o, ALIGN);
+      if (o->magic != OBJ_MAGIC || o->ctor_cnt != 1 || o->use_cnt != 0)
+        fail ("object %d was not freshly constructed", i);
+      o->use_cnt++;
+    }
+  msg ("Allocated %d objects.", OBJ_CNT);
+
+  /* Free every other object and allocate them again, which must
+     hand out the same objects in their used state. */
+  for (i = 0; i < OBJ_CNT; i += 2)
+    kmem_cache_free (cache, objs[i]);
+  for (i = 0; i < OBJ_CNT; i += 2) 
+    {
+      struct obj *o = objs[i] = kmem_cache_alloc (cache);
+      if (o == NULL)
+        fail ("reallocation %d failed", i);
+      if (o->magic != OBJ_MAGIC || o->ctor_cnt != 1 || o->use_cnt != 1)
+        fail ("reallocated object %d lost its state", i);
+    }
+  msg ("Freed objects kept their constructed state.");
+
+  if (total_ctor_cnt < OBJ_CNT)
+    fail ("constructor ran %d times for %d objects",
+          total_ctor_cnt, OBJ_CNT);
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (cache, objs[i]);
+  kmem_cache_destroy (cache);
+  msg ("Cache destroyed.");
+}
+
+/* Constructor for struct obj. */
+static void
+obj_ctor (void *o_) 
+{
+  struct obj *o = o_;
+
+  o->magic = OBJ_MAGIC;
+  o->ctor_cnt = 1;
+  o->use_cnt = 0;
+  total_ctor_cnt++;
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) Allocated 100 objects.
+(slab-cache) Freed objects kept their constructed state.
+(slab-cache) Cache destroyed.
+(slab-cache) end
+EOF
+pass;
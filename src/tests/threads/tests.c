@@ -17,6 +17,7 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-stress", test_alarm_stress},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -25,11 +26,27 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-rwlock", test_priority_donate_rwlock},
+    {"priority-donate-rwlock-chain", test_priority_donate_rwlock_chain},
+    {"rwlock-writer-pref", test_rwlock_writer_pref},
+    {"lockdep-inversion", test_lockdep_inversion},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
- /*
+    {"deadline-edf", test_deadline_edf},
+    {"workqueue", test_workqueue},
+    {"slab-cache", test_slab_cache},
+    {"palloc-borrow", test_palloc_borrow},
+    {"malloc-realloc", test_malloc_realloc},
+    {"bench-switch", test_bench_switch},
+    {"bench-create", test_bench_create},
+    {"bench-donate", test_bench_donate},
+    {"bench-lock", test_bench_lock},
+    {"bench-rwlock", test_bench_rwlock},
+    {"bench-palloc", test_bench_palloc},
+    {"bench-palloc-64", test_bench_palloc_64},
+    {"bench-malloc", test_bench_malloc},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -39,6 +56,7 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+ /*
     {"hello", test_hello},
 */
   };
@@ -11,6 +11,7 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_stress;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -19,11 +20,27 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_rwlock;
+extern test_func test_priority_donate_rwlock_chain;
+extern test_func test_rwlock_writer_pref;
+extern test_func test_lockdep_inversion;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
-/*
+extern test_func test_deadline_edf;
+extern test_func test_workqueue;
+extern test_func test_slab_cache;
+extern test_func test_palloc_borrow;
+extern test_func test_malloc_realloc;
+extern test_func test_bench_switch;
+extern test_func test_bench_create;
+extern test_func test_bench_donate;
+extern test_func test_bench_lock;
+extern test_func test_bench_rwlock;
+extern test_func test_bench_palloc;
+extern test_func test_bench_palloc_64;
+extern test_func test_bench_malloc;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -33,6 +50,7 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+/*
 extern test_func test_hello;
 */
 void msg (const char *, ...);
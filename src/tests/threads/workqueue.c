@@ -0,0 +1,74 @@
+/* Submits many work items to a work queue from a kernel thread
+   and checks that wq_flush() waits for all of them, then submits
+   delayed work, which reaches the queue from the timer interrupt
+   handler, and checks that it runs no sooner than requested. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define WORKER_CNT 4
+#define WORK_CNT 200
+#define DELAY 10
+
+static wq_func count_func;
+static wq_func delayed_func;
+
+static int count;
+static int64_t delayed_ticks;
+static struct semaphore delayed_sema;
+
+void
+test_workqueue (void) 
+{
+  struct workqueue *wq;
+  struct wq_delayed dw;
+  int64_t start;
+  int i;
+
+  wq = wq_create (WORKER_CNT, PRI_DEFAULT);
+  ASSERT (wq != NULL);
+
+  for (i = 0; i < WORK_CNT; i++)
+    if (!wq_submit (wq, count_func, NULL))
+      fail ("submitting work item %d failed", i);
+  msg ("Submitted %d work items to %d workers.", WORK_CNT, WORKER_CNT);
+  wq_flush (wq);
+  if (count != WORK_CNT)
+    fail ("only %d of %d work items ran before wq_flush() returned",
+          count, WORK_CNT);
+  msg ("All %d work items ran.", WORK_CNT);
+
+  sema_init (&delayed_sema, 0);
+  start = timer_ticks ();
+  wq_submit_delayed (wq, &dw, delayed_func, NULL, DELAY);
+  sema_down (&delayed_sema);
+  if (delayed_ticks - start < DELAY)
+    fail ("delayed work ran after %lld ticks instead of %d",
+          delayed_ticks - start, DELAY);
+  msg ("Delayed work ran after at least %d ticks.", DELAY);
+
+  wq_destroy (wq);
+  msg ("Work queue destroyed.");
+}
+
+static void
+count_func (void *aux UNUSED) 
+{
+  enum intr_level old_level = intr_disable ();
+  count++;
+  intr_set_level (old_level);
+  thread_yield ();
+}
+
+static void
+delayed_func (void *aux UNUSED) 
+{
+  delayed_ticks = timer_ticks ();
+  sema_up (&delayed_sema);
+}
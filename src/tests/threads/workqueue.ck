@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) Submitted 200 work items to 4 workers.
+(workqueue) All 200 work items ran.
+(workqueue) Delayed work ran after at least 10 ticks.
+(workqueue) Work queue destroyed.
+(workqueue) end
+EOF
+pass;
@@ -0,0 +1,48 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdint.h>
+
+/* Maximum number of CPUs. */
+#define CPU_MAX 8
+
+/* Number of CPUs in use.  CPU 0 is the bootstrap processor;
+   smp_start() brings up the others one at a time. */
+extern unsigned cpu_cnt;
+
+unsigned cpu_id (void);
+
+/* Feature flags returned in EDX by CPUID leaf 1. */
+#define CPUID_PSE (1 << 3)      /* 4 MB pages. */
+
+/* Executes CPUID for LEAF and returns the value it leaves in
+   EDX.  See [IA32-v2a] "CPUID". */
+static inline uint32_t
+cpuid_edx (uint32_t leaf)
+{
+  uint32_t eax = leaf, ebx, ecx = 0, edx;
+  asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+  return edx;
+}
+
+/* Returns the current value of the processor's time-stamp
+   counter, which counts clock cycles since reset.
+   See [IA32-v2b] "RDTSC". */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Tells the processor that we are in a spin-wait loop, which
+   saves power and avoids a memory-order mis-speculation penalty
+   when the loop exits.  See [IA32-v2b] "PAUSE". */
+static inline void
+cpu_relax (void)
+{
+  asm volatile ("pause" : : : "memory");
+}
+
+#endif /* threads/cpu.h */
@@ -13,13 +13,20 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
+#include "threads/memstat.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
+#include "threads/lockstat.h"
+#include "threads/profile.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -86,7 +93,11 @@ main (void)
   /* Initialize memory system. */
   palloc_init ();
   malloc_init ();
+  kmem_init ();
   paging_init ();
+  smp_init ();
+  trace_init ();
+  profile_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -106,8 +117,11 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  palloc_start ();
+  memstat_start ();
   serial_init_queue ();
   timer_calibrate ();
+  smp_start ();
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -115,6 +129,7 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+  kmem_print_savings ();
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -143,6 +158,9 @@ ram_init (void)
   ram_pages = *(uint32_t *) ptov (LOADER_RAM_PGS);
 }
 
+/* Page Size Extensions bit in CR4. */
+#define CR4_PSE 0x00000010
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points base_page_dir to the page
@@ -151,12 +169,19 @@ ram_init (void)
    At the time this function is called, the active page table
    (set up by loader.S) only maps the first 4 MB of RAM, so we
    should not try to use extravagant amounts of memory.
-   Fortunately, there is no need to do so. */
+   Fortunately, there is no need to do so.
+
+   If the CPU supports 4 MB pages, each 4 MB of RAM that holds no
+   kernel text is mapped by a single PDE, which saves a page
+   table per 4 MB and a TLB entry for every 1,024 pages.  The 4 MB
+   that hold the kernel text are mapped with 4 kB pages, so that
+   the text can be read-only. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
+  bool pse = (cpuid_edx (1) & CPUID_PSE) != 0;
   extern char _start, _end_kernel_text;
 
   pd = base_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -169,6 +194,15 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      /* Map a whole 4 MB with one PDE, if we can. */
+      if (pse && pte_idx == 0 && ram_pages - page >= PTSPAN / PGSIZE
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_kernel_large (vaddr, true);
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -178,6 +212,15 @@ paging_init (void)
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
     }
 
+  /* Let PDEs map 4 MB pages.  See [IA32-v3a] 2.5 "Control
+     Registers". */
+  if (pse)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+    }
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -244,6 +287,43 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-trace"))
+        trace_enabled = true;
+      else if (!strcmp (name, "-profile"))
+        {
+          profile_enabled = true;
+          if (value != NULL)
+            profile_interval = atoi (value);
+        }
+      else if (!strcmp (name, "-memstat"))
+        memstat_interval = value != NULL ? atoi (value) : TIMER_FREQ;
+#ifdef LOCKSTAT
+      else if (!strcmp (name, "-lockstat"))
+        lockstat_enabled = true;
+#endif
+      else if (!strcmp (name, "-smp"))
+        {
+          int cpus;
+
+          if (value == NULL)
+            PANIC ("-smp requires a value (use -smp=N)");
+          cpus = atoi (value);
+          if (cpus < 1)
+            PANIC ("-smp must be at least 1");
+          smp_max_cpus = cpus;
+        }
+      else if (!strcmp (name, "-up"))
+        {
+          /* 0 or 100 would leave one of the pools with no pages
+             at all, which palloc_init() cannot set up. */
+          if (value == NULL)
+            PANIC ("-up requires a value (use -up=PERCENT)");
+          user_page_percent = atoi (value);
+          if (user_page_percent < 1 || user_page_percent > 99)
+            PANIC ("-up must be between 1 and 99");
+        }
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -349,6 +429,15 @@ usage (void)
           "  -f                 Format file system disk during startup.\n"
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the timer tick while the CPU is idle.\n"
+          "  -trace             Trace scheduler events for utils/trace2json.\n"
+          "  -profile[=N]       Sample every N ticks (default 1) for utils/profile.\n"
+          "  -memstat[=N]       Print memory statistics every N ticks (default 100).\n"
+#ifdef LOCKSTAT
+          "  -lockstat          Print lock contention statistics at shutdown.\n"
+#endif
+          "  -smp=N             Use up to N CPUs (default: 1).\n"
+          "  -up=PERCENT        Give PERCENT%% of memory to user pool (default 50).\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -369,6 +458,8 @@ power_off (void)
   filesys_done ();
 #endif
 
+  trace_dump ();
+  profile_dump ();
   print_stats ();
 
   printf ("Powering off...\n");
@@ -387,6 +478,9 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  palloc_print_stats ();
+  if (memstat_interval > 0)
+    memstat_print ();
 #ifdef FILESYS
   disk_print_stats ();
 #endif
@@ -395,4 +489,7 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef LOCKSTAT
+  lockstat_print ();
+#endif
 }
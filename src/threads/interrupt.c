@@ -3,10 +3,14 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
 
@@ -31,9 +35,51 @@ static const char *intr_names[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+   interrupt returns.  Each CPU handles its own external
+   interrupts, so these are kept per CPU. */
+static bool in_external_intr[CPU_MAX]; /* In an external interrupt? */
+static bool yield_on_return[CPU_MAX];  /* Yield on interrupt return? */
+
+/* Big kernel lock.
+
+   Much of the kernel turns interrupts off to keep other threads
+   from running, which is enough on one CPU but not on several.
+   So a CPU acquires the big kernel lock whenever it turns
+   interrupts off and releases it whenever it turns them back on,
+   that is, a CPU holds the lock exactly when its interrupts are
+   off.
+
+   This is a big kernel lock design, not a fine-grained one.
+   Everything that runs with interrupts off runs on one CPU at a
+   time, machine-wide: the scheduler, every spinlock's critical
+   section (spin_lock() requires interrupts off), the run queues
+   and the malloc magazines.  While this lock exists, spinlocks
+   and run queue locks can never contend, and per-CPU data is
+   per-CPU only in where it lives, not in how much runs in
+   parallel.  What does run on several CPUs at once is code with
+   interrupts on: user programs and kernel code outside of
+   interrupts-off sections, such as code that holds only sleeping
+   locks.
+
+   Entering an interrupt gate turns interrupts off without
+   intr_disable(), and returning from it may turn them back on,
+   so intr_handler() acquires and releases the lock to match.
+   The bootstrap processor starts with interrupts off, so the
+   lock starts out held.
+
+   The lock is held from one thread to the next across a thread
+   switch, so it is a bare ticket lock rather than a struct
+   spinlock, whose lock-order checking tracks holders by
+   thread. */
+static struct
+  {
+    uint16_t owner;             /* Ticket now being served. */
+    uint16_t next;              /* Next ticket to hand out. */
+  }
+bkl = {0, 1};
+
+static void bkl_acquire (void);
+static void bkl_release (void);
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
@@ -77,6 +123,9 @@ intr_enable (void)
   enum intr_level old_level = intr_get_level ();
   ASSERT (!intr_context ());
 
+  if (old_level == INTR_OFF)
+    bkl_release ();
+
   /* Enable interrupts by setting the interrupt flag.
 
      See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -97,8 +146,57 @@ intr_disable (void)
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
 
+  if (old_level == INTR_ON)
+    bkl_acquire ();
+
   return old_level;
 }
+
+/* Enables interrupts, which must be off, and halts the CPU
+   until the next interrupt arrives.  Used by the idle thread.
+
+   The `sti' instruction disables interrupts until the completion
+   of the next instruction, so these two instructions are
+   executed atomically.  This atomicity is important; otherwise,
+   an interrupt could be handled between re-enabling interrupts
+   and waiting for the next one to occur, wasting as much as one
+   clock tick worth of time.  An inter-processor interrupt sent
+   after the big kernel lock is released is likewise held off
+   until the `hlt'.
+
+   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
+   7.11.1 "HLT Instruction". */
+void
+intr_wait (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!intr_context ());
+
+  bkl_release ();
+  asm volatile ("sti; hlt" : : : "memory");
+}
+
+/* Acquires the big kernel lock for the running CPU, spinning
+   until the CPU holding it turns interrupts back on.  Waiters
+   are served in the order in which they arrive. */
+static void
+bkl_acquire (void) 
+{
+  uint16_t ticket = 1;
+
+  asm volatile ("lock xaddw %0, %1"
+                : "+r" (ticket), "+m" (bkl.next) : : "memory");
+  while (*(volatile uint16_t *) &bkl.owner != ticket)
+    cpu_relax ();
+}
+
+/* Releases the big kernel lock, which the running CPU must hold. */
+static void
+bkl_release (void) 
+{
+  barrier ();
+  *(volatile uint16_t *) &bkl.owner = bkl.owner + 1;
+}
 
 /* Initializes the interrupt system. */
 void
@@ -144,6 +242,20 @@ intr_init (void)
   intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Initializes the interrupt system on an application processor,
+   which starts out with interrupts off but without the big
+   kernel lock: acquires the lock and loads the IDT that
+   intr_init() set up. */
+void
+intr_init_ap (void) 
+{
+  uint64_t idtr_operand;
+
+  bkl_acquire ();
+  idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
+  asm volatile ("lidt %0" : : "m" (idtr_operand));
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -161,6 +273,14 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
   intr_names[vec_no] = name;
 }
 
+/* Returns true if VEC_NO is an external interrupt, that is, one
+   from a device through the PICs or one from the local APIC. */
+static bool
+is_external (uint8_t vec_no) 
+{
+  return (vec_no >= 0x20 && vec_no <= 0x2f) || vec_no >= INTR_LAPIC_MIN;
+}
+
 /* Registers external interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The handler will
    execute with interrupts disabled. */
@@ -168,7 +288,7 @@ void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
                    const char *name) 
 {
-  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+  ASSERT (is_external (vec_no));
   register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -189,7 +309,7 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
                    intr_handler_func *handler, const char *name)
 {
-  ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+  ASSERT (!is_external (vec_no));
   register_handler (vec_no, dpl, level, handler, name);
 }
 
@@ -198,7 +318,10 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  /* With interrupts on, the running thread may move to another
+     CPU at any time, but then it cannot be in an external
+     interrupt either. */
+  return intr_get_level () == INTR_OFF && in_external_intr[cpu_id ()];
 }
 
 /* During processing of an external interrupt, directs the
@@ -209,7 +332,7 @@ void
 intr_yield_on_return (void) 
 {
   ASSERT (intr_context ());
-  yield_on_return = true;
+  yield_on_return[cpu_id ()] = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -341,25 +464,36 @@ intr_handler (struct intr_frame *frame)
   bool external;
   intr_handler_func *handler;
 
+  /* If an interrupt gate just turned interrupts off, take the
+     big kernel lock, as intr_disable() would have. */
+  if (intr_get_level () == INTR_OFF && (frame->eflags & FLAG_IF))
+    bkl_acquire ();
+
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
-     and they need to be acknowledged on the PIC (see below).
-     An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+     and they need to be acknowledged on the PIC or local APIC
+     (see below).  An external interrupt handler cannot sleep. */
+  external = is_external (frame->vec_no);
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (!intr_context ());
 
-      in_external_intr = true;
-      yield_on_return = false;
+      in_external_intr[cpu_id ()] = true;
+      yield_on_return[cpu_id ()] = false;
+
+      /* Restart the periodic timer if we were idle without it. */
+      timer_idle_exit (frame->vec_no == 0x20);
     }
 
+  trace_event (TRACE_INTR_ENTER, thread_tid (), frame->vec_no);
+
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
     handler (frame);
-  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
+  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+           || frame->vec_no == LAPIC_VEC_SPURIOUS)
     {
       /* There is no handler, but this interrupt can trigger
          spuriously due to a hardware fault or hardware race
@@ -373,18 +507,29 @@ intr_handler (struct intr_frame *frame)
       PANIC ("Unexpected interrupt"); 
     }
 
+  trace_event (TRACE_INTR_EXIT, thread_tid (), frame->vec_no);
+
   /* Complete the processing of an external interrupt. */
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (intr_context ());
 
-      in_external_intr = false;
-      pic_end_of_interrupt (frame->vec_no); 
+      in_external_intr[cpu_id ()] = false;
+      if (frame->vec_no < INTR_LAPIC_MIN)
+        pic_end_of_interrupt (frame->vec_no); 
+      else if (frame->vec_no != LAPIC_VEC_SPURIOUS)
+        lapic_eoi ();
 
-      if (yield_on_return) 
+      if (yield_on_return[cpu_id ()]) 
         thread_yield (); 
     }
+
+  /* If returning will turn interrupts back on, release the big
+     kernel lock.  After a thread switch we may be on another CPU, but
+     that CPU holds the lock too, since its interrupts are off. */
+  if (intr_get_level () == INTR_OFF && (frame->eflags & FLAG_IF))
+    bkl_release ();
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
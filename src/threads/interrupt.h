@@ -15,6 +15,13 @@ enum intr_level intr_get_level (void);
 enum intr_level intr_set_level (enum intr_level);
 enum intr_level intr_enable (void);
 enum intr_level intr_disable (void);
+void intr_wait (void);
+
+/* Vectors 0x20...0x2f receive device interrupts from the PICs.
+   Vectors INTR_LAPIC_MIN and up receive interrupts from the
+   local APIC: timer ticks and inter-processor interrupts on
+   multiprocessors.  Both kinds are external interrupts. */
+#define INTR_LAPIC_MIN 0xf0
 
 /* Interrupt stack frame. */
 struct intr_frame
@@ -58,6 +65,7 @@ struct intr_frame
 typedef void intr_handler_func (struct intr_frame *);
 
 void intr_init (void);
+void intr_init_ap (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
@@ -29,6 +29,12 @@
 #define LOADER_ARG_CNT_LEN 4
 #define LOADER_RAM_PGS_LEN 4
 
+/* Physical address at which application processors start, in
+   real mode, when they receive a STARTUP IPI.  smp_start()
+   copies threads/ap-start.S here.  Must be page-aligned and below
+   1 MB, and must not overlap the loader. */
+#define AP_START 0x8000
+
 /* GDT selectors defined by loader.
    More selectors are defined by userprog/gdt.h. */
 #define SEL_NULL        0x00    /* Null selector. */
@@ -0,0 +1,369 @@
+#include "threads/lockdep.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Lock-order checking.
+
+   Two threads that acquire the same two locks in opposite orders
+   can deadlock, but usually don't, so the bug hides until a test
+   hangs.  We catch it the first time the orders disagree, even
+   if no deadlock happens.
+
+   Orders are kept between classes of locks (see struct
+   lock_class in synch.h), not individual locks, so that the
+   order seen for one inode's lock, say, applies to all of them.
+   Each thread keeps a stack of the locks it holds.  Acquiring a
+   lock of class B while holding one of class A records the order
+   "A before B" as an edge in a graph of classes.  If B already
+   comes before A in the graph, directly or through other
+   classes, the acquisition could deadlock, and we panic with the
+   call chains of both orders.
+
+   When every order between the held locks and the new lock is
+   already known, which is nearly always, checking costs one bit
+   test per held lock.  Only a new edge searches the graph.
+
+   Locks of the same class held together, like the locks of two
+   queues, are not checked against each other.  Neither are
+   spinlocks taken by interrupt handlers. */
+
+#ifndef NDEBUG
+
+/* Maximum number of classes and edges.  When these run out, a
+   warning is printed and checking stops. */
+#define CLASS_MAX 256
+#define EDGE_MAX 512
+
+/* Number of return addresses saved in a call chain. */
+#define CHAIN_DEPTH 8
+
+/* An edge in the order graph: a lock of class FROM was held,
+   having been acquired by the caller at HELD_SITE, when a lock
+   of class TO was acquired with call chain CHAIN. */
+struct edge
+  {
+    uint16_t from, to;          /* Class IDs. */
+    uintptr_t held_site;        /* Acquirer of the FROM lock. */
+    uintptr_t chain[CHAIN_DEPTH]; /* Call chain for the TO lock. */
+  };
+
+/* Classes by ID.  ID 0 is not used. */
+static struct lock_class *classes[CLASS_MAX];
+static int class_cnt = 1;
+
+/* Adjacency matrix: bit TO of order[FROM] is set if there is an
+   edge from FROM to TO. */
+static uint32_t order[CLASS_MAX][CLASS_MAX / 32];
+
+/* The edges, for reporting. */
+static struct edge edges[EDGE_MAX];
+static int edge_cnt;
+
+/* Set when checking has stopped. */
+static bool disabled;
+
+static void add_edge (const struct lockdep_held *, struct lock_class *,
+                      uintptr_t site);
+static bool find_path (int from, int to, int path[]);
+static void report (const struct lockdep_held *, struct lock_class *,
+                    const int path[], uintptr_t site) NO_RETURN;
+static void save_chain (uintptr_t chain[CHAIN_DEPTH], uintptr_t site);
+static void print_chain (const uintptr_t chain[CHAIN_DEPTH]);
+static const char *class_name (const struct lock_class *);
+static void give_up (const char *why);
+
+/* Gives CLASS an ID, if it does not have one yet. */
+void
+lockdep_register (struct lock_class *class)
+{
+  enum intr_level old_level;
+
+  if (class == NULL)
+    return;
+
+  old_level = intr_disable ();
+  if (class->id == 0 && !disabled)
+    {
+      if (class_cnt < CLASS_MAX)
+        {
+          class->id = class_cnt++;
+          classes[class->id] = class;
+        }
+      else
+        give_up ("too many lock classes");
+    }
+  intr_set_level (old_level);
+}
+
+/* Checks that the running thread may acquire a lock of CLASS,
+   at the request of the caller at SITE, given the locks it
+   already holds.  Panics if not.  Called before waiting for the
+   lock, so that a deadlock is reported rather than suffered. */
+void
+lockdep_check (struct lock_class *class, uintptr_t site)
+{
+  struct thread *t;
+  enum intr_level old_level;
+  int i;
+
+  if (class == NULL || class->id == 0 || disabled || intr_context ())
+    return;
+
+  old_level = intr_disable ();
+  t = thread_current ();
+  for (i = 0; i < t->lockdep_depth && !disabled; i++)
+    {
+      const struct lockdep_held *h = &t->lockdep_held[i];
+      int from = h->class->id;
+      int to = class->id;
+
+      if (from != to && from != 0
+          && (order[from][to / 32] & (1u << (to % 32))) == 0)
+        add_edge (h, class, site);
+    }
+  intr_set_level (old_level);
+}
+
+/* Records that the running thread has acquired a lock of CLASS,
+   at the request of the caller at SITE. */
+void
+lockdep_acquired (struct lock_class *class, uintptr_t site)
+{
+  struct thread *t;
+  enum intr_level old_level;
+
+  if (class == NULL || intr_context ())
+    return;
+
+  old_level = intr_disable ();
+  t = thread_current ();
+  if (t->lockdep_depth >= LOCKDEP_HELD_MAX)
+    PANIC ("thread `%s' holds more than %d locks",
+           t->name, LOCKDEP_HELD_MAX);
+  t->lockdep_held[t->lockdep_depth].class = class;
+  t->lockdep_held[t->lockdep_depth].site = site;
+  t->lockdep_depth++;
+  intr_set_level (old_level);
+}
+
+/* Records that the running thread has released a lock of
+   CLASS.  Locks need not be released in the reverse of the order
+   in which they were acquired. */
+void
+lockdep_release (struct lock_class *class)
+{
+  struct thread *t;
+  enum intr_level old_level;
+  int i;
+
+  if (class == NULL || intr_context ())
+    return;
+
+  old_level = intr_disable ();
+  t = thread_current ();
+  for (i = t->lockdep_depth - 1; i >= 0; i--)
+    if (t->lockdep_held[i].class == class)
+      {
+        t->lockdep_depth--;
+        memmove (&t->lockdep_held[i], &t->lockdep_held[i + 1],
+                 (t->lockdep_depth - i) * sizeof *t->lockdep_held);
+        break;
+      }
+  intr_set_level (old_level);
+}
+
+/* Adds an edge from H's class to CLASS, which is being acquired
+   by the caller at SITE while H is held, unless there is already
+   a path from CLASS to H's class, in which case the orders
+   conflict and we panic. */
+static void
+add_edge (const struct lockdep_held *h, struct lock_class *class,
+          uintptr_t site)
+{
+  static int path[CLASS_MAX];
+  int from = h->class->id;
+  int to = class->id;
+  struct edge *e;
+
+  if (find_path (to, from, path))
+    report (h, class, path, site);
+
+  if (edge_cnt >= EDGE_MAX)
+    {
+      give_up ("too many lock orders");
+      return;
+    }
+  order[from][to / 32] |= 1u << (to % 32);
+  e = &edges[edge_cnt++];
+  e->from = from;
+  e->to = to;
+  e->held_site = h->site;
+  save_chain (e->chain, site);
+}
+
+/* Searches the order graph for a path from class FROM to class
+   TO.  If there is one, stores the classes along it, starting
+   with FROM and ending with TO, into PATH followed by 0, and
+   returns true.  Otherwise returns false. */
+static bool
+find_path (int from, int to, int path[])
+{
+  static uint32_t visited[CLASS_MAX / 32];
+  static int parent[CLASS_MAX];
+  static int queue[CLASS_MAX];
+  int head = 0, tail = 0;
+  int len, c;
+
+  /* Breadth-first search, so that the path reported is as short
+     as possible. */
+  memset (visited, 0, sizeof visited);
+  visited[from / 32] |= 1u << (from % 32);
+  parent[from] = 0;
+  queue[tail++] = from;
+  while (head < tail)
+    {
+      int cur = queue[head++];
+      int next;
+
+      if (cur == to)
+        break;
+      for (next = 1; next < class_cnt; next++)
+        if ((order[cur][next / 32] & (1u << (next % 32))) != 0
+            && (visited[next / 32] & (1u << (next % 32))) == 0)
+          {
+            visited[next / 32] |= 1u << (next % 32);
+            parent[next] = cur;
+            queue[tail++] = next;
+          }
+    }
+  if ((visited[to / 32] & (1u << (to % 32))) == 0)
+    return false;
+
+  /* Walk back from TO, then reverse. */
+  len = 0;
+  for (c = to; c != 0; c = parent[c])
+    path[len++] = c;
+  path[len] = 0;
+  for (c = 0; c < len / 2; c++)
+    {
+      int t = path[c];
+      path[c] = path[len - 1 - c];
+      path[len - 1 - c] = t;
+    }
+  return true;
+}
+
+/* Reports that acquiring CLASS at SITE while holding H conflicts
+   with the earlier orders along PATH, from CLASS to H's class,
+   and panics. */
+static void
+report (const struct lockdep_held *h, struct lock_class *class,
+        const int path[], uintptr_t site)
+{
+  uintptr_t chain[CHAIN_DEPTH];
+  int i;
+
+  /* Printing takes the console lock, which must not come back
+     here. */
+  disabled = true;
+
+  printf ("\nlockdep: lock order inversion in thread `%s'.\n"
+          "Acquiring %s\nwhile holding %s, acquired at %#"PRIxPTR",\n",
+          thread_name (), class_name (class), class_name (h->class),
+          h->site);
+  printf ("from:");
+  save_chain (chain, site);
+  print_chain (chain);
+
+  printf ("But earlier:\n");
+  for (i = 0; path[i + 1] != 0; i++)
+    {
+      int e;
+
+      for (e = 0; e < edge_cnt; e++)
+        if (edges[e].from == path[i] && edges[e].to == path[i + 1])
+          break;
+      ASSERT (e < edge_cnt);
+      printf ("%s was acquired while holding %s,\n"
+              "acquired at %#"PRIxPTR", from:",
+              class_name (classes[path[i + 1]]), class_name (classes[path[i]]),
+              edges[e].held_site);
+      print_chain (edges[e].chain);
+    }
+
+  PANIC ("lock order inversion");
+}
+
+/* Saves into CHAIN the call chain of a lock acquisition by the
+   caller at SITE.  The chain starts at SITE and continues with
+   SITE's callers, found by following frame pointers from the
+   current frame. */
+static void
+save_chain (uintptr_t chain[CHAIN_DEPTH], uintptr_t site)
+{
+  void **frame;
+  void *stack = pg_round_down (__builtin_frame_address (0));
+  int i = 0;
+
+  memset (chain, 0, sizeof *chain * CHAIN_DEPTH);
+  chain[i++] = site;
+
+  /* Skip the frames within synch.c and this file, up to the one
+     that returns to SITE. */
+  for (frame = __builtin_frame_address (0);
+       pg_round_down (frame) == stack && frame[0] != NULL;
+       frame = frame[0])
+    if ((uintptr_t) frame[1] == site)
+      break;
+  if (pg_round_down (frame) != stack || frame[0] == NULL)
+    return;
+
+  for (frame = frame[0];
+       i < CHAIN_DEPTH && pg_round_down (frame) == stack && frame[0] != NULL;
+       frame = frame[0])
+    chain[i++] = (uintptr_t) frame[1];
+}
+
+/* Prints CHAIN, as debug_backtrace() would. */
+static void
+print_chain (const uintptr_t chain[CHAIN_DEPTH])
+{
+  int i;
+
+  for (i = 0; i < CHAIN_DEPTH && chain[i] != 0; i++)
+    printf (" %#"PRIxPTR, chain[i]);
+  printf (".\n");
+}
+
+/* Returns a description of CLASS for reports. */
+static const char *
+class_name (const struct lock_class *class)
+{
+  static char buf[2][128];
+  static int which;
+  const char *file = class->file;
+
+  while (!memcmp (file, "../", 3))
+    file += 3;
+  which = !which;
+  snprintf (buf[which], sizeof buf[which], "`%s' (%s:%d)",
+            class->name, file, class->line);
+  return buf[which];
+}
+
+/* Stops checking, after printing WHY. */
+static void
+give_up (const char *why)
+{
+  disabled = true;
+  printf ("lockdep: %s, lock order checking disabled.\n", why);
+}
+
+#endif /* NDEBUG */
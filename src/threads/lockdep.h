@@ -0,0 +1,32 @@
+#ifndef THREADS_LOCKDEP_H
+#define THREADS_LOCKDEP_H
+
+#include <stdint.h>
+
+struct lock_class;
+
+/* Maximum number of locks that a thread may hold at once. */
+#define LOCKDEP_HELD_MAX 16
+
+/* A lock held by a thread. */
+struct lockdep_held
+  {
+    struct lock_class *class;   /* Its class. */
+    uintptr_t site;             /* Caller that acquired it. */
+  };
+
+/* Lock-order checking is done along with assertions, that is,
+   unless NDEBUG is defined. */
+#ifdef NDEBUG
+#define lockdep_register(CLASS) ((void) 0)
+#define lockdep_check(CLASS, SITE) ((void) 0)
+#define lockdep_acquired(CLASS, SITE) ((void) 0)
+#define lockdep_release(CLASS) ((void) 0)
+#else
+void lockdep_register (struct lock_class *);
+void lockdep_check (struct lock_class *, uintptr_t site);
+void lockdep_acquired (struct lock_class *, uintptr_t site);
+void lockdep_release (struct lock_class *);
+#endif
+
+#endif /* threads/lockdep.h */
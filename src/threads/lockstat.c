@@ -0,0 +1,156 @@
+#include "threads/lockstat.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+/* Lock statistics.
+
+   Built only when LOCKSTAT is defined, which "make LOCKSTAT=1"
+   does.  Then synch.c reports each acquisition and release of a
+   lock here, along with how long the acquirer waited and how
+   long the lock was held, and statistics are kept for each class
+   of locks.
+   The "-lockstat" kernel option turns collection on, and the
+   totals for each class are printed at shutdown, most contended
+   first.
+
+   Statistics are updated with interrupts off, which all of the
+   callers in synch.c already have. */
+
+#ifdef LOCKSTAT
+
+/* Set by the "-lockstat" kernel command-line option. */
+bool lockstat_enabled;
+
+/* Registered classes, linked through `next'. */
+static struct lock_class *classes;
+
+static bool more_contended (const struct lock_class *,
+                            const struct lock_class *);
+static const char *short_file_name (const char *);
+
+/* Adds CLASS to the list of classes, if it is not already there.
+   Called each time a lock is initialized. */
+void
+lockstat_register (struct lock_class *class)
+{
+  enum intr_level old_level;
+
+  if (class == NULL)
+    return;
+
+  old_level = intr_disable ();
+  if (!class->registered)
+    {
+      class->registered = true;
+      class->next = classes;
+      classes = class;
+    }
+  intr_set_level (old_level);
+}
+
+/* Records an acquisition of a lock in CLASS, which waited WAIT
+   cycles, by a caller at address SITE.  CONTENDED is true if the
+   lock was held by another thread or CPU when requested. */
+void
+lockstat_acquired (struct lock_class *class, bool contended,
+                   uint64_t wait, uintptr_t site)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!lockstat_enabled || class == NULL)
+    return;
+
+  class->acquired++;
+  if (contended)
+    {
+      class->contended++;
+      class->wait_total += wait;
+      if (wait > class->wait_max)
+        {
+          class->wait_max = wait;
+          class->wait_max_site = site;
+        }
+    }
+}
+
+/* Records a release of a lock in CLASS that was held HOLD
+   cycles. */
+void
+lockstat_released (struct lock_class *class, uint64_t hold)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!lockstat_enabled || class == NULL)
+    return;
+
+  class->hold_total += hold;
+  if (hold > class->hold_max)
+    class->hold_max = hold;
+}
+
+/* Prints the statistics for each class that was acquired at
+   least once, most contended first.  The site of the longest
+   wait can be turned into a function name with the `backtrace'
+   utility. */
+void
+lockstat_print (void)
+{
+  struct lock_class *sorted = NULL;
+  struct lock_class *c, *next;
+
+  if (!lockstat_enabled)
+    return;
+  lockstat_enabled = false;
+
+  /* Insertion sort into SORTED.  There are only a few dozen
+     classes. */
+  for (c = classes; c != NULL; c = next)
+    {
+      struct lock_class **p = &sorted;
+
+      next = c->next;
+      while (*p != NULL && !more_contended (c, *p))
+        p = &(*p)->next;
+      c->next = *p;
+      *p = c;
+    }
+  classes = sorted;
+
+  printf ("Lock statistics (times in cycles):\n"
+          "%10s %9s %12s %10s %12s %10s %10s  %s\n",
+          "acquired", "contended", "wait-total", "wait-max",
+          "hold-total", "hold-max", "wait-site", "class");
+  for (c = classes; c != NULL; c = c->next)
+    if (c->acquired > 0)
+      printf ("%10"PRIu64" %9"PRIu64" %12"PRIu64" %10"PRIu64
+              " %12"PRIu64" %10"PRIu64" %#10"PRIxPTR"  %s (%s:%d)\n",
+              c->acquired, c->contended, c->wait_total, c->wait_max,
+              c->hold_total, c->hold_max, c->wait_max_site,
+              c->name, short_file_name (c->file), c->line);
+}
+
+/* Returns true if A should be listed before B: if it had more
+   contended acquisitions, or as many but a longer total wait. */
+static bool
+more_contended (const struct lock_class *a, const struct lock_class *b)
+{
+  if (a->contended != b->contended)
+    return a->contended > b->contended;
+  return a->wait_total > b->wait_total;
+}
+
+/* Returns FILE without the leading "../" components that come
+   from compiling in the build directory. */
+static const char *
+short_file_name (const char *file)
+{
+  while (!memcmp (file, "../", 3))
+    file += 3;
+  return file;
+}
+
+#endif /* LOCKSTAT */
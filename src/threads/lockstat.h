@@ -0,0 +1,18 @@
+#ifndef THREADS_LOCKSTAT_H
+#define THREADS_LOCKSTAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct lock_class;
+
+/* Set by the "-lockstat" kernel command-line option. */
+extern bool lockstat_enabled;
+
+void lockstat_register (struct lock_class *);
+void lockstat_acquired (struct lock_class *, bool contended,
+                        uint64_t wait, uintptr_t site);
+void lockstat_released (struct lock_class *, uint64_t hold);
+void lockstat_print (void);
+
+#endif /* threads/lockstat.h */
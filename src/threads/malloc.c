@@ -5,6 +5,9 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -28,19 +31,55 @@
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   Taking the descriptor's lock for every request is slow, so
+   each CPU keeps a small "magazine" of free blocks for each
+   descriptor, which it accesses with interrupts off but without
+   the lock.  malloc() takes a block from the magazine and free()
+   puts one back.  Only when the magazine is empty does malloc()
+   take the lock, to refill it with half a magazine's worth of
+   blocks from the free list, and only when it is full does
+   free() take the lock, to move half of its blocks back.  Blocks
+   in a magazine count as in use, so an arena can be kept from
+   being freed by at most a magazine's worth of blocks on each
+   CPU.
+
+   Blocks from 2 kB to 8 kB don't fit in a single page with a
+   descriptor, so their descriptors use arenas of several pages,
+   each holding about four blocks.  The arena header is only at
+   the start of the arena's first page, so for each page of RAM
+   we keep a count, in `arena_offsets', of the pages between it
+   and the start of its arena, which is 0 except in the later
+   pages of a multi-page arena.
+
+   We handle blocks bigger than 8 kB, and blocks that would take
+   more memory in a multi-page arena than on pages of their own,
+   by allocating contiguous pages with the page allocator and
+   sticking the allocation size at the beginning of the allocated
+   block's arena header.  realloc() resizes such a "big block" in
+   place when the pages that follow it are free. */
+
+/* Maximum number of blocks in a magazine. */
+#define MAG_MAX 16
+
+/* Per-CPU cache of free blocks for a descriptor. */
+struct magazine
+  {
+    size_t cnt;                 /* Number of blocks in `blocks'. */
+    struct block *blocks[MAG_MAX]; /* Free blocks, most recent last. */
+  };
 
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
+    size_t arena_pages;         /* Number of pages in an arena. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
-    struct lock lock;           /* Lock. */
+    struct spinlock lock;       /* Lock. */
+    size_t arena_cnt;           /* Number of arenas. */
+    size_t free_cnt;            /* Number of blocks in free_list. */
+    size_t mag_size;            /* Capacity of each magazine. */
+    struct magazine mags[CPU_MAX]; /* Magazine for each CPU. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -60,28 +99,73 @@ struct block
     struct list_elem free_elem; /* Free list element. */
   };
 
+/* Block sizes of descriptors with multi-page arenas. */
+static const size_t large_sizes[] = {2048, 3072, 4096, 6144, 8192};
+
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[12];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* For each physical page, the number of pages back to the start
+   of the arena that the page is in. */
+static uint8_t *arena_offsets;
+
+/* Big blocks, for statistics. */
+static struct spinlock big_lock;
+static size_t big_cnt;          /* Number of big blocks. */
+static size_t big_pages;        /* Pages in big blocks. */
+
+static void init_desc (size_t block_size, size_t arena_pages);
+static struct desc *size_to_desc (size_t size);
+static size_t big_footprint (size_t size);
+static bool resize_in_place (void *block, size_t new_size);
+static void set_arena_offsets (struct arena *, size_t page_cnt, bool);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static bool refill (struct desc *, struct magazine *);
+static void flush (struct desc *, struct magazine *);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) 
 {
   size_t block_size;
+  size_t i;
 
   for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
-    {
-      struct desc *d = &descs[desc_cnt++];
-      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-      d->block_size = block_size;
-      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-      list_init (&d->free_list);
-      lock_init (&d->lock);
-    }
+    init_desc (block_size, 1);
+
+  /* Give each multi-page arena room for four blocks. */
+  for (i = 0; i < sizeof large_sizes / sizeof *large_sizes; i++)
+    init_desc (large_sizes[i], DIV_ROUND_UP (4 * large_sizes[i]
+                                             + sizeof (struct arena),
+                                             PGSIZE));
+  arena_offsets = palloc_get_multiple (PAL_ASSERT | PAL_ZERO,
+                                       DIV_ROUND_UP (ram_pages, PGSIZE));
+  spin_init_named (&big_lock, "malloc big");
+}
+
+/* Initializes a descriptor for blocks of BLOCK_SIZE bytes in
+   arenas of ARENA_PAGES pages. */
+static void
+init_desc (size_t block_size, size_t arena_pages)
+{
+  struct desc *d = &descs[desc_cnt++];
+
+  ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+  ASSERT (arena_pages <= UINT8_MAX);
+  d->block_size = block_size;
+  d->arena_pages = arena_pages;
+  d->blocks_per_arena = ((PGSIZE * arena_pages - sizeof (struct arena))
+                         / block_size);
+  list_init (&d->free_list);
+  spin_init_named (&d->lock, "malloc desc");
+  d->arena_cnt = d->free_cnt = 0;
+
+  /* Don't let a magazine of big blocks hold more than an
+     arena's worth, to limit the memory idle in magazines. */
+  d->mag_size = (d->blocks_per_arena < MAG_MAX
+                 ? d->blocks_per_arena : MAG_MAX);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -90,21 +174,20 @@ void *
 malloc (size_t size) 
 {
   struct desc *d;
+  struct magazine *m;
   struct block *b;
   struct arena *a;
+  enum intr_level old_level;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
     return NULL;
 
-  /* Find the smallest descriptor that satisfies a SIZE-byte
-     request. */
-  for (d = descs; d < descs + desc_cnt; d++)
-    if (d->block_size >= size)
-      break;
-  if (d == descs + desc_cnt) 
+  d = size_to_desc (size);
+  if (d == NULL) 
     {
-      /* SIZE is too big for any descriptor.
+      /* SIZE is too big for any descriptor, or takes less memory
+         as a big block.
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
@@ -116,40 +199,25 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+
+      old_level = spin_lock_irqsave (&big_lock);
+      big_cnt++;
+      big_pages += page_cnt;
+      spin_unlock_irqrestore (&big_lock, old_level);
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  /* Take a block from this CPU's magazine, refilling it first
+     if it is empty. */
+  old_level = intr_disable ();
+  m = &d->mags[cpu_id ()];
+  if (m->cnt == 0 && !refill (d, m))
     {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
+      intr_set_level (old_level);
+      return NULL;
     }
-
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
-  lock_release (&d->lock);
+  b = m->blocks[--m->cnt];
+  intr_set_level (old_level);
   return b;
 }
 
@@ -174,6 +242,55 @@ calloc (size_t a, size_t b)
   return p;
 }
 
+/* Returns the number of bytes of memory that malloc(SIZE) takes,
+   including its share of its arena's header and unused space. */
+size_t
+malloc_footprint (size_t size)
+{
+  struct desc *d = size_to_desc (size);
+
+  return (d != NULL
+          ? PGSIZE * d->arena_pages / d->blocks_per_arena
+          : big_footprint (size));
+}
+
+/* Stores statistics for each malloc() size class, and for blocks
+   too big for any of them, into STATS.  The counts of free blocks
+   include blocks in other CPUs' magazines, which may be slightly
+   out of date. */
+void
+malloc_get_stats (struct memstat *stats) 
+{
+  enum intr_level old_level;
+  size_t i;
+
+  ASSERT (desc_cnt <= MEMSTAT_CLASSES);
+  stats->class_cnt = desc_cnt;
+  for (i = 0; i < desc_cnt; i++)
+    {
+      struct desc *d = &descs[i];
+      struct memstat_class *c = &stats->classes[i];
+      size_t free_cnt;
+      unsigned cpu;
+
+      old_level = spin_lock_irqsave (&d->lock);
+      free_cnt = d->free_cnt;
+      for (cpu = 0; cpu < cpu_cnt; cpu++)
+        free_cnt += d->mags[cpu].cnt;
+      c->block_size = d->block_size;
+      c->arena_cnt = d->arena_cnt;
+      c->free_cnt = free_cnt;
+      c->in_use = (d->arena_cnt * d->blocks_per_arena - free_cnt)
+                  * d->block_size;
+      spin_unlock_irqrestore (&d->lock, old_level);
+    }
+
+  old_level = spin_lock_irqsave (&big_lock);
+  stats->big_cnt = big_cnt;
+  stats->big_pages = big_pages;
+  spin_unlock_irqrestore (&big_lock, old_level);
+}
+
 /* Returns the number of bytes allocated for BLOCK. */
 static size_t
 block_size (void *block) 
@@ -199,6 +316,8 @@ realloc (void *old_block, size_t new_size)
       free (old_block);
       return NULL;
     }
+  else if (old_block != NULL && resize_in_place (old_block, new_size))
+    return old_block;
   else 
     {
       void *new_block = malloc (new_size);
@@ -226,6 +345,9 @@ free (void *p)
       
       if (d != NULL) 
         {
+          struct magazine *m;
+          enum intr_level old_level;
+
           /* It's a normal block.  We handle it here. */
 
 #ifndef NDEBUG
@@ -233,49 +355,124 @@ free (void *p)
           memset (b, 0xcc, d->block_size);
 #endif
   
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
-            {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
-            }
-
-          lock_release (&d->lock);
+          /* Put the block in this CPU's magazine, making room
+             first if it is full. */
+          old_level = intr_disable ();
+          m = &d->mags[cpu_id ()];
+          if (m->cnt >= d->mag_size)
+            flush (d, m);
+          m->blocks[m->cnt++] = b;
+          intr_set_level (old_level);
         }
       else
         {
+          enum intr_level old_level;
+
           /* It's a big block.  Free its pages. */
+          old_level = spin_lock_irqsave (&big_lock);
+          big_cnt--;
+          big_pages -= a->free_cnt;
+          spin_unlock_irqrestore (&big_lock, old_level);
+
           palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
 }
 
+/* Returns the descriptor for a SIZE-byte request, which is the
+   smallest one with big enough blocks, or a null pointer if
+   there is none or if a big block would take less memory. */
+static struct desc *
+size_to_desc (size_t size)
+{
+  struct desc *d;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->block_size >= size)
+      {
+        if (d->arena_pages > 1
+            && (PGSIZE * d->arena_pages / d->blocks_per_arena
+                >= big_footprint (size)))
+          return NULL;
+        return d;
+      }
+  return NULL;
+}
+
+/* Returns the number of bytes in a big block of SIZE bytes. */
+static size_t
+big_footprint (size_t size)
+{
+  return DIV_ROUND_UP (size + sizeof (struct arena), PGSIZE) * PGSIZE;
+}
+
+/* Tries to resize BLOCK to NEW_SIZE bytes without moving it.
+   Returns true if successful, false if BLOCK must be moved. */
+static bool
+resize_in_place (void *block, size_t new_size)
+{
+  struct arena *a = block_to_arena (block);
+  enum intr_level old_level;
+  size_t old_cnt, new_cnt;
+
+  /* A block from a descriptor stays where it is if the new size
+     belongs with the same descriptor. */
+  if (a->desc != NULL)
+    return size_to_desc (new_size) == a->desc;
+
+  /* A big block that has shrunk enough to belong with a
+     descriptor moves there. */
+  if (size_to_desc (new_size) != NULL)
+    return false;
+
+  /* Otherwise, a big block gives back the pages it no longer
+     needs, or takes the free pages that follow it. */
+  old_cnt = a->free_cnt;
+  new_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+  if (new_cnt < old_cnt)
+    palloc_free_multiple ((uint8_t *) a + PGSIZE * new_cnt,
+                          old_cnt - new_cnt);
+  else if (!palloc_grow_multiple (a, old_cnt, new_cnt))
+    return false;
+
+  a->free_cnt = new_cnt;
+  old_level = spin_lock_irqsave (&big_lock);
+  big_pages += new_cnt - old_cnt;
+  spin_unlock_irqrestore (&big_lock, old_level);
+  return true;
+}
+
+/* Records that the PAGE_CNT pages starting at arena A belong to
+   A, if IN_USE is true, or no longer do, if it is false. */
+static void
+set_arena_offsets (struct arena *a, size_t page_cnt, bool in_use)
+{
+  size_t first = vtop (a) >> PGBITS;
+  size_t i;
+
+  for (i = 1; i < page_cnt; i++)
+    arena_offsets[first + i] = in_use ? i : 0;
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
 {
   struct arena *a = pg_round_down (b);
 
+  /* Find the arena's first page. */
+  a = (struct arena *) ((uint8_t *) a
+                        - PGSIZE * arena_offsets[vtop (a) >> PGBITS]);
+
   /* Check that the arena is valid. */
   ASSERT (a != NULL);
   ASSERT (a->magic == ARENA_MAGIC);
 
   /* Check that the block is properly aligned for the arena. */
   ASSERT (a->desc == NULL
-          || (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+          || (((uint8_t *) b - (uint8_t *) a - sizeof *a)
+              % a->desc->block_size) == 0);
   ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
   return a;
@@ -292,3 +489,105 @@ arena_to_block (struct arena *a, size_t idx)
                            + sizeof *a
                            + idx * a->desc->block_size);
 }
+
+/* Fills half of magazine M, which must be empty and belong to the
+   running CPU, with blocks from D's free list, creating a new
+   arena if the free list is empty.  Returns true if successful,
+   false if no page is available for an arena.  Interrupts must
+   be off. */
+static bool
+refill (struct desc *d, struct magazine *m)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (m->cnt == 0);
+
+  spin_lock (&d->lock);
+
+  /* If the free list is empty, create a new arena. */
+  if (list_empty (&d->free_list))
+    {
+      struct arena *a;
+      size_t i;
+
+      /* Allocate the arena's pages. */
+      a = palloc_get_multiple (0, d->arena_pages);
+      if (a == NULL) 
+        {
+          spin_unlock (&d->lock);
+          return false;
+        }
+
+      /* Initialize arena and add its blocks to the free list. */
+      set_arena_offsets (a, d->arena_pages, true);
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_push_back (&d->free_list, &b->free_elem);
+        }
+      d->arena_cnt++;
+      d->free_cnt += d->blocks_per_arena;
+    }
+
+  /* Move blocks from the free list to the magazine. */
+  while (m->cnt < DIV_ROUND_UP (d->mag_size, 2)
+         && !list_empty (&d->free_list))
+    {
+      struct block *b = list_entry (list_pop_front (&d->free_list),
+                                    struct block, free_elem);
+      block_to_arena (b)->free_cnt--;
+      d->free_cnt--;
+      m->blocks[m->cnt++] = b;
+    }
+
+  spin_unlock (&d->lock);
+  return true;
+}
+
+/* Moves the least recently freed half of the blocks in magazine
+   M, which must belong to the running CPU, back to D's free
+   list, freeing any arena that becomes entirely unused.
+   Interrupts must be off. */
+static void
+flush (struct desc *d, struct magazine *m)
+{
+  size_t flush_cnt = DIV_ROUND_UP (m->cnt, 2);
+  size_t i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  spin_lock (&d->lock);
+  for (i = 0; i < flush_cnt; i++) 
+    {
+      struct block *b = m->blocks[i];
+      struct arena *a = block_to_arena (b);
+
+      /* Add block to free list. */
+      list_push_front (&d->free_list, &b->free_elem);
+      d->free_cnt++;
+
+      /* If the arena is now entirely unused, free it. */
+      if (++a->free_cnt >= d->blocks_per_arena) 
+        {
+          size_t j;
+
+          ASSERT (a->free_cnt == d->blocks_per_arena);
+          for (j = 0; j < d->blocks_per_arena; j++) 
+            {
+              struct block *b = arena_to_block (a, j);
+              list_remove (&b->free_elem);
+            }
+          set_arena_offsets (a, d->arena_pages, false);
+          palloc_free_multiple (a, d->arena_pages);
+          d->arena_cnt--;
+          d->free_cnt -= d->blocks_per_arena;
+        }
+    }
+  spin_unlock (&d->lock);
+
+  /* Slide the remaining, more recently freed blocks down. */
+  m->cnt -= flush_cnt;
+  memmove (m->blocks, m->blocks + flush_cnt, m->cnt * sizeof *m->blocks);
+}
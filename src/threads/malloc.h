@@ -2,6 +2,7 @@
 #define THREADS_MALLOC_H
 
 #include <debug.h>
+#include <memstat.h>
 #include <stddef.h>
 
 void malloc_init (void);
@@ -9,5 +10,7 @@ void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+size_t malloc_footprint (size_t);
+void malloc_get_stats (struct memstat *);
 
 #endif /* threads/malloc.h */
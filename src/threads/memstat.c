@@ -0,0 +1,92 @@
+#include "threads/memstat.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+
+/* Memory statistics.
+
+   Gathers the page allocator's per-pool counters and malloc()'s
+   per-size-class counters into a struct memstat, which user
+   programs obtain with the memstat system call, and prints them
+   on the console, every memstat_interval ticks if the "-memstat"
+   option is given and at shutdown. */
+
+/* Print interval in timer ticks, or 0 to print only at shutdown
+   or on request. */
+int memstat_interval;
+
+static thread_func memstat_thread;
+
+/* Starts printing memory statistics periodically, if requested
+   with "-memstat".  Must be called after thread_start(). */
+void
+memstat_start (void) 
+{
+  if (memstat_interval > 0)
+    thread_create ("memstat", PRI_DEFAULT, memstat_thread, NULL);
+}
+
+/* Stores current memory statistics into STATS. */
+void
+memstat_get (struct memstat *stats) 
+{
+  palloc_get_stats (stats->pools);
+  malloc_get_stats (stats);
+}
+
+/* Prints current memory statistics. */
+void
+memstat_print (void) 
+{
+  static const char *pool_names[MEMSTAT_POOLS] = {"kernel", "user"};
+  struct memstat stats;
+  size_t i;
+
+  memstat_get (&stats);
+  printf ("memstat: at tick %"PRId64"\n", timer_ticks ());
+  for (i = 0; i < MEMSTAT_POOLS; i++)
+    {
+      const struct memstat_pool *p = &stats.pools[i];
+
+      printf ("memstat: %s pool: %"PRIu32" of %"PRIu32" pages free, "
+              "%"PRIu32" zeroed, largest free block %"PRIu32" pages\n",
+              pool_names[i], p->free_cnt, p->page_cnt, p->zeroed_cnt,
+              p->largest_free);
+      printf ("memstat: %s pool: %"PRIu64" allocations "
+              "(%"PRIu64" PAL_ZERO, %"PRIu64" PAL_ASSERT), "
+              "%"PRIu64" failures, %"PRIu64" times low\n",
+              pool_names[i], p->allocs, p->zero_allocs, p->assert_allocs,
+              p->failures, p->low_events);
+      printf ("memstat: %s pool: %"PRIu32" pages lent, "
+              "%"PRIu32" pages borrowed, %"PRIu64" borrowing allocations, "
+              "%"PRIu64" reclaims\n",
+              pool_names[i], p->lent_cnt, p->borrowed_cnt, p->borrows,
+              p->reclaims);
+    }
+  for (i = 0; i < stats.class_cnt; i++)
+    {
+      const struct memstat_class *c = &stats.classes[i];
+
+      if (c->arena_cnt > 0)
+        printf ("memstat: malloc %"PRIu32": %"PRIu32" arenas, "
+                "%"PRIu32" free blocks, %"PRIu32" bytes in use\n",
+                c->block_size, c->arena_cnt, c->free_cnt, c->in_use);
+    }
+  printf ("memstat: malloc big: %"PRIu32" blocks, %"PRIu32" pages\n",
+          stats.big_cnt, stats.big_pages);
+}
+
+/* Prints memory statistics every memstat_interval ticks. */
+static void
+memstat_thread (void *aux UNUSED) 
+{
+  for (;;)
+    {
+      timer_sleep (memstat_interval);
+      memstat_print ();
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef THREADS_MEMSTAT_H
+#define THREADS_MEMSTAT_H
+
+#include <memstat.h>
+
+/* Set by the "-memstat" kernel command-line option: print memory
+   statistics every memstat_interval timer ticks, or never if 0. */
+extern int memstat_interval;
+
+void memstat_start (void);
+void memstat_get (struct memstat *);
+void memstat_print (void);
+
+#endif /* threads/memstat.h */
@@ -2,15 +2,19 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/init.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "threads/workqueue.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -24,25 +28,153 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+   The "-up" option changes the split, and "-ul" caps the user
+   pool.
+
+   Neither pool has to be the right size, because a pool that
+   runs out of pages borrows them from the other pool.  The
+   lender allocates the pages as usual and marks them in its
+   `lent_map', so that they go back to it when they are freed,
+   and it keeps twice its low watermark to itself.  The lender
+   cannot take borrowed pages back by force, so when it runs low
+   itself while it has pages lent out, it reclaims them by
+   calling the low-memory handlers for the borrower as well as
+   for itself.  The user pool does not borrow if "-ul" is given,
+   since that would defeat the limit.
+
+   Each pool is a binary buddy allocator.  Its free pages are
+   grouped into blocks of 2**ORDER pages, for ORDER from 0 to
+   PAL_ORDERS - 1, each aligned on a multiple of its size within
+   the pool.  A block's "buddy" is the other half of the block of
+   the next order up.  Free blocks are kept on a list per order,
+   linked through their first pages, so that allocating takes the
+   first block on the smallest nonempty list of a big enough
+   order, splitting off and freeing its upper halves until it is
+   the right size.  Freeing a block merges it with its buddy, if
+   that is free, and so on up.  Both take O(log n) time in the
+   number of pages in the pool.
+
+   A request for a number of pages that is not a power of 2 takes
+   a block of the next larger order and frees the pages past the
+   end of the request, so that no memory is wasted, and
+   palloc_free_multiple() can free any run of allocated pages by
+   breaking it into aligned blocks.  palloc_grow_multiple() can
+   likewise extend a run in place by carving the pages that
+   follow it out of the free blocks that hold them.
+
+   Zeroing a page for PAL_ZERO takes thousands of cycles, so a
+   "zeroer" thread that runs at the lowest priority, when nothing
+   else wants the CPU, keeps a few pages of each pool zeroed in
+   advance on the pool's `zero_list'.  A single-page PAL_ZERO
+   request takes a page from that list if it can.  The pages on
+   the list count as allocated, and they are linked through their
+   first bytes, which are cleared again when the page is handed
+   out.  When a pool runs out of free pages, its zeroed pages are
+   given back to the buddy allocator before failing.
+
+   When the pages available in a pool, free or zeroed, fall below
+   the pool's low watermark, the pool calls the low-memory
+   handlers registered with palloc_register_low(), so that
+   subsystems that cache memory can give some back.  The
+   allocator may be running in an interrupt handler or under a
+   spinlock, so the handlers run later, from a work queue.  They
+   run once each time the pool falls below the watermark, which
+   is re-armed once the pool has twice as many pages available. */
+
+/* Number of block orders.  The largest block, of 2**20 pages,
+   spans the whole 32-bit address space. */
+#define PAL_ORDERS 21
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct spinlock lock;               /* Mutual exclusion. */
+    struct bitmap *used_map;            /* Bitmap of used pages. */
+    uint8_t *free_order;                /* For each page, ORDER + 1 if it
+                                           starts a free block, else 0. */
+    struct list free_lists[PAL_ORDERS]; /* Free blocks by order. */
+    size_t free_cnt;                    /* Pages in free blocks. */
     uint8_t *base;                      /* Base of pool. */
+    enum palloc_flags flags;            /* PAL_USER for user pool. */
+
+    /* Borrowing. */
+    struct pool *other;                 /* The other pool. */
+    bool may_borrow;                    /* May borrow from `other'? */
+    struct bitmap *lent_map;            /* Pages lent to `other'. */
+    size_t lent_cnt;                    /* Number of pages lent. */
+
+    /* Pages zeroed in advance. */
+    struct list zero_list;              /* Zeroed pages. */
+    size_t zero_cnt;                    /* Number of pages in zero_list. */
+    size_t zero_max;                    /* Maximum for zero_cnt. */
+    bool zeroer_waiting;                /* Zeroer waits for this pool? */
+
+    /* Low-memory notification. */
+    size_t low_water;                   /* Low watermark, in pages. */
+    bool low;                           /* Below watermark, not re-armed? */
+    bool low_pending;                   /* Handlers about to run? */
+    struct wq_delayed low_work;         /* Runs the handlers. */
+
+    /* Statistics. */
+    long long zero_hits;                /* Requests served from zero_list. */
+    long long zero_misses;              /* Requests zeroed by caller. */
+    long long zeroed_cnt;               /* Pages zeroed by the zeroer. */
+    uint64_t zeroed_cycles;             /* Cycles zeroing those pages. */
+    long long allocs;                   /* Successful allocations. */
+    long long zero_allocs;              /* ...with PAL_ZERO. */
+    long long assert_allocs;            /* ...with PAL_ASSERT. */
+    long long failures;                 /* Failed allocations. */
+    long long low_events;               /* Times below low watermark. */
+    long long borrows;                  /* Allocations from `other'. */
+    long long reclaims;                 /* Times lent pages reclaimed. */
   };
 
+/* Most pages a pool keeps zeroed in advance. */
+#define ZERO_MAX 64
+
 /* Two pools: one for kernel data, one for user pages. */
 struct pool kernel_pool, user_pool;
 
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
 
+/* Percentage of free memory to put in user pool. */
+int user_page_percent = 50;
+
+/* Upped to wake the zeroer thread. */
+static struct semaphore zeroer_sema;
+
+/* Low-memory handlers. */
+static struct list low_handlers;
+static struct lock low_lock;
+
+/* Work queue that runs the low-memory handlers. */
+static struct workqueue *low_wq;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
+static struct pool *page_pool (void *page);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t alloc_pages (struct pool *, size_t page_cnt, int order);
+static void *borrow_pages (struct pool *, size_t page_cnt, int order);
+static size_t alloc_block (struct pool *, int order);
+static void take_free_range (struct pool *, size_t page_idx,
+                             size_t page_cnt);
+static void free_block (struct pool *, size_t page_idx, int order);
+static void free_pages (struct pool *, size_t page_idx, size_t page_cnt);
+static struct list_elem *block_elem (const struct pool *, size_t page_idx);
+static void *take_zeroed_page (struct pool *, bool *wake_zeroer);
+static bool release_zeroed_pages (struct pool *);
+static bool zero_page (struct pool *);
+static thread_func zeroer;
+static bool account (struct pool *, enum palloc_flags, bool success,
+                     bool borrowed);
+static bool check_low (struct pool *, bool failed);
+static void notify_low (struct pool *);
+static wq_func run_low_handlers;
+static void call_low_handlers (struct pool *);
+static void get_pool_stats (struct pool *, struct memstat_pool *);
 
 /* Initializes the page allocator. */
 void
@@ -56,16 +188,25 @@ palloc_init (void)
   uint8_t *free_start = pg_round_up (&_end);
   uint8_t *free_end = ptov (ram_pages * PGSIZE);
   size_t free_pages = (free_end - free_start) / PGSIZE;
-  size_t user_pages = free_pages / 2;
+  size_t user_pages = free_pages * user_page_percent / 100;
   size_t kernel_pages;
   if (user_pages > user_page_limit)
     user_pages = user_page_limit;
   kernel_pages = free_pages - user_pages;
 
-  /* Give half of memory to kernel, half to user. */
+  /* Split memory between kernel and user. */
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+  user_pool.flags = PAL_USER;
+  kernel_pool.other = &user_pool;
+  user_pool.other = &kernel_pool;
+  kernel_pool.may_borrow = true;
+  user_pool.may_borrow = user_page_limit == SIZE_MAX;
+
+  sema_init (&zeroer_sema, 0);
+  list_init (&low_handlers);
+  lock_init (&low_lock);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -78,24 +219,55 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
+  bool wake_zeroer = false;
+  bool zeroed = false;
+  bool borrowed = false;
+  bool low;
   void *pages;
   size_t page_idx;
+  int order;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  for (order = 0; order < PAL_ORDERS; order++)
+    if (page_cnt <= (size_t) 1 << order)
+      break;
 
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  old_level = spin_lock_irqsave (&pool->lock);
+  pages = NULL;
+  if ((flags & PAL_ZERO) && page_cnt == 1)
+    {
+      pages = take_zeroed_page (pool, &wake_zeroer);
+      zeroed = pages != NULL;
+    }
+  if (pages == NULL)
+    {
+      page_idx = alloc_pages (pool, page_cnt, order);
+      if (page_idx == BITMAP_ERROR && release_zeroed_pages (pool))
+        page_idx = alloc_pages (pool, page_cnt, order);
+      if (page_idx != BITMAP_ERROR)
+        pages = pool->base + PGSIZE * page_idx;
+    }
+  if (pages == NULL && pool->may_borrow)
+    {
+      /* Only one pool's lock is held at a time. */
+      spin_unlock_irqrestore (&pool->lock, old_level);
+      pages = borrow_pages (pool, page_cnt, order);
+      borrowed = pages != NULL;
+      old_level = spin_lock_irqsave (&pool->lock);
+    }
+  low = account (pool, flags, pages != NULL, borrowed);
+  spin_unlock_irqrestore (&pool->lock, old_level);
+  if (wake_zeroer)
+    sema_up (&zeroer_sema);
+  if (low)
+    notify_low (pool);
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if ((flags & PAL_ZERO) && !zeroed)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -125,27 +297,34 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
     return;
 
-  if (page_from_pool (&kernel_pool, pages))
-    pool = &kernel_pool;
-  else if (page_from_pool (&user_pool, pages))
-    pool = &user_pool;
-  else
-    NOT_REACHED ();
-
+  pool = page_pool (pages);
   page_idx = pg_no (pages) - pg_no (pool->base);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = spin_lock_irqsave (&pool->lock);
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  if (pool->lent_cnt > 0)
+    {
+      /* Pages lent to the other pool come back to this one. */
+      pool->lent_cnt -= bitmap_count (pool->lent_map, page_idx, page_cnt,
+                                      true);
+      bitmap_set_multiple (pool->lent_map, page_idx, page_cnt, false);
+    }
+  free_pages (pool, page_idx, page_cnt);
+  if (pool->low && pool->free_cnt + pool->zero_cnt >= 2 * pool->low_water)
+    pool->low = false;
+  spin_unlock_irqrestore (&pool->lock, old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -155,15 +334,142 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Tries to extend the PAGE_CNT pages starting at PAGES, which
+   must have been obtained from palloc_get_multiple(), to NEW_CNT
+   pages without moving them, by allocating the pages that follow
+   them.  Returns true if successful, false if those pages are not
+   all free.  To shrink a run of pages, free its tail with
+   palloc_free_multiple() instead. */
+bool
+palloc_grow_multiple (void *pages, size_t page_cnt, size_t new_cnt)
+{
+  struct pool *pool;
+  enum intr_level old_level;
+  size_t page_idx, grow_idx, grow_cnt;
+  bool success = false;
+  bool low = false;
+
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (page_cnt > 0);
+  ASSERT (new_cnt >= page_cnt);
+  if (new_cnt == page_cnt)
+    return true;
+
+  pool = page_pool (pages);
+  page_idx = pg_no (pages) - pg_no (pool->base);
+  grow_idx = page_idx + page_cnt;
+  grow_cnt = new_cnt - page_cnt;
+
+  old_level = spin_lock_irqsave (&pool->lock);
+  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+  if (grow_cnt <= bitmap_size (pool->used_map) - grow_idx
+      && bitmap_none (pool->used_map, grow_idx, grow_cnt))
+    {
+      /* Pages lent to the other pool can only grow as far as
+         borrow_pages() would lend. */
+      bool lent = bitmap_test (pool->lent_map, page_idx);
+
+      if (!lent || pool->free_cnt >= grow_cnt + 2 * pool->low_water)
+        {
+          take_free_range (pool, grow_idx, grow_cnt);
+          bitmap_set_multiple (pool->used_map, grow_idx, grow_cnt, true);
+          if (lent)
+            {
+              bitmap_set_multiple (pool->lent_map, grow_idx, grow_cnt, true);
+              pool->lent_cnt += grow_cnt;
+            }
+          success = true;
+          low = check_low (pool, false);
+        }
+    }
+  spin_unlock_irqrestore (&pool->lock, old_level);
+  if (low)
+    notify_low (pool);
+
+  return success;
+}
+
+/* Starts the thread that zeroes pages in advance and the work
+   queue that runs low-memory handlers.  Must be called after
+   thread_start(). */
+void
+palloc_start (void) 
+{
+  thread_create ("zeroer", PRI_MIN, zeroer, NULL);
+  low_wq = wq_create (1, PRI_DEFAULT);
+  if (low_wq == NULL)
+    PANIC ("palloc: low-memory work queue creation failed");
+}
+
+/* Registers H to call FUNC, with AUX as its last argument, each
+   time a pool runs low on memory.  FUNC is called from a kernel
+   thread and may sleep and acquire locks.  It should free what
+   memory it can spare from the given pool, identified by its
+   flags: PAL_USER for the user pool, 0 for the kernel pool. */
+void
+palloc_register_low (struct palloc_low_handler *h, palloc_low_func *func,
+                     void *aux) 
+{
+  h->func = func;
+  h->aux = aux;
+  lock_acquire (&low_lock);
+  list_push_back (&low_handlers, &h->elem);
+  lock_release (&low_lock);
+}
+
+/* Unregisters H, which must have been registered with
+   palloc_register_low().  Once this returns, H's function is no
+   longer running or going to be called. */
+void
+palloc_unregister_low (struct palloc_low_handler *h) 
+{
+  lock_acquire (&low_lock);
+  list_remove (&h->elem);
+  lock_release (&low_lock);
+}
+
+/* Stores statistics for the kernel and user pools into
+   STATS[MEMSTAT_KERNEL] and STATS[MEMSTAT_USER]. */
+void
+palloc_get_stats (struct memstat_pool stats[MEMSTAT_POOLS]) 
+{
+  get_pool_stats (&kernel_pool, &stats[MEMSTAT_KERNEL]);
+  get_pool_stats (&user_pool, &stats[MEMSTAT_USER]);
+  stats[MEMSTAT_KERNEL].borrowed_cnt = stats[MEMSTAT_USER].lent_cnt;
+  stats[MEMSTAT_USER].borrowed_cnt = stats[MEMSTAT_KERNEL].lent_cnt;
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) 
+{
+  long long hits = kernel_pool.zero_hits + user_pool.zero_hits;
+  long long misses = kernel_pool.zero_misses + user_pool.zero_misses;
+  long long zeroed = kernel_pool.zeroed_cnt + user_pool.zeroed_cnt;
+  uint64_t cycles = kernel_pool.zeroed_cycles + user_pool.zeroed_cycles;
+
+  printf ("Zeroed pages: %lld hits, %lld misses",
+          hits, misses);
+  if (hits + misses > 0)
+    printf (" (%lld%% hits)", hits * 100 / (hits + misses));
+  if (zeroed > 0)
+    printf (", about %"PRIu64" cycles of zeroing saved",
+            cycles / zeroed * hits);
+  printf ("\n");
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map, lent_map, and free_order at
+     its base.  Calculate the space needed for them and subtract
+     it from the pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (2 * bm_size + page_cnt, PGSIZE);
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -171,9 +477,45 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  spin_init_named (&p->lock, "palloc pool");
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->lent_map = bitmap_create_in_buf (page_cnt, (uint8_t *) base + bm_size,
+                                      bm_size);
+  p->lent_cnt = 0;
+  p->free_order = (uint8_t *) base + 2 * bm_size;
+  memset (p->free_order, 0, page_cnt);
+  for (order = 0; order < PAL_ORDERS; order++)
+    list_init (&p->free_lists[order]);
+  p->free_cnt = 0;
   p->base = base + bm_pages * PGSIZE;
+  free_pages (p, 0, page_cnt);
+
+  list_init (&p->zero_list);
+  p->zero_cnt = 0;
+  p->zero_max = page_cnt / 16 < ZERO_MAX ? page_cnt / 16 : ZERO_MAX;
+  p->zeroer_waiting = false;
+  p->flags = 0;
+  p->other = NULL;
+  p->may_borrow = false;
+  p->low_water = page_cnt / 16;
+  p->low = p->low_pending = false;
+  p->zero_hits = p->zero_misses = p->zeroed_cnt = 0;
+  p->zeroed_cycles = 0;
+  p->allocs = p->zero_allocs = p->assert_allocs = 0;
+  p->failures = p->low_events = 0;
+  p->borrows = p->reclaims = 0;
+}
+
+/* Returns the pool that PAGE was allocated from. */
+static struct pool *
+page_pool (void *page) 
+{
+  if (page_from_pool (&kernel_pool, page))
+    return &kernel_pool;
+  else if (page_from_pool (&user_pool, page))
+    return &user_pool;
+  else
+    NOT_REACHED ();
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -187,3 +529,411 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Allocates PAGE_CNT pages from POOL, taking a free block of
+   2**ORDER pages and freeing the pages past the end of the
+   request.  Returns the index of the first page, or BITMAP_ERROR
+   if POOL has no free block that large.  POOL's lock must be
+   held. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt, int order)
+{
+  size_t page_idx;
+
+  if (order >= PAL_ORDERS)
+    return BITMAP_ERROR;
+  page_idx = alloc_block (pool, order);
+  if (page_idx == BITMAP_ERROR)
+    return BITMAP_ERROR;
+
+  /* Give back the pages past the end of the request. */
+  free_pages (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+  ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+  return page_idx;
+}
+
+/* Borrows PAGE_CNT pages for POOL from the other pool, which
+   lends them only if it keeps twice its low watermark free
+   afterward.  ORDER is as for alloc_pages().  Returns the pages,
+   or a null pointer if they cannot be borrowed.  No pool's lock
+   may be held. */
+static void *
+borrow_pages (struct pool *pool, size_t page_cnt, int order)
+{
+  struct pool *lender = pool->other;
+  enum intr_level old_level;
+  size_t page_idx = BITMAP_ERROR;
+
+  old_level = spin_lock_irqsave (&lender->lock);
+  if (lender->free_cnt >= page_cnt + 2 * lender->low_water)
+    page_idx = alloc_pages (lender, page_cnt, order);
+  if (page_idx != BITMAP_ERROR)
+    {
+      bitmap_set_multiple (lender->lent_map, page_idx, page_cnt, true);
+      lender->lent_cnt += page_cnt;
+    }
+  spin_unlock_irqrestore (&lender->lock, old_level);
+
+  return page_idx != BITMAP_ERROR ? lender->base + PGSIZE * page_idx : NULL;
+}
+
+/* Removes a free block of 2**ORDER pages from POOL and returns
+   the index of its first page, or BITMAP_ERROR if POOL has no
+   free block that large.  POOL's lock must be held. */
+static size_t
+alloc_block (struct pool *pool, int order)
+{
+  struct list_elem *e;
+  size_t page_idx;
+  int k;
+
+  for (k = order; k < PAL_ORDERS; k++)
+    if (!list_empty (&pool->free_lists[k]))
+      break;
+  if (k >= PAL_ORDERS)
+    return BITMAP_ERROR;
+
+  e = list_pop_front (&pool->free_lists[k]);
+  page_idx = pg_no (e) - pg_no (pool->base);
+  ASSERT (pool->free_order[page_idx] == k + 1);
+  pool->free_order[page_idx] = 0;
+  pool->free_cnt -= (size_t) 1 << order;
+
+  /* Split the block, freeing the upper half each time. */
+  while (k > order)
+    {
+      size_t buddy;
+
+      k--;
+      buddy = page_idx + ((size_t) 1 << k);
+      pool->free_order[buddy] = k + 1;
+      list_push_front (&pool->free_lists[k], block_elem (pool, buddy));
+    }
+  return page_idx;
+}
+
+/* Removes the PAGE_CNT pages starting at PAGE_IDX, all of which
+   must be free, from POOL's free blocks.  Each free block that
+   holds some of them is taken whole, and its pages outside the
+   range are freed again.  POOL's lock must be held. */
+static void
+take_free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  size_t end = page_idx + page_cnt;
+
+  while (page_idx < end)
+    {
+      size_t block_idx, block_end;
+      int order;
+
+      /* Find the free block that holds PAGE_IDX. */
+      for (order = 0; order < PAL_ORDERS; order++)
+        {
+          block_idx = page_idx & ~(((size_t) 1 << order) - 1);
+          if (pool->free_order[block_idx] == order + 1)
+            break;
+        }
+      ASSERT (order < PAL_ORDERS);
+      block_end = block_idx + ((size_t) 1 << order);
+
+      list_remove (block_elem (pool, block_idx));
+      pool->free_order[block_idx] = 0;
+      pool->free_cnt -= (size_t) 1 << order;
+
+      /* Free the parts of the block before and after the range. */
+      free_pages (pool, block_idx, page_idx - block_idx);
+      if (block_end > end)
+        {
+          free_pages (pool, end, block_end - end);
+          block_end = end;
+        }
+      page_idx = block_end;
+    }
+}
+
+/* Adds the block of 2**ORDER pages starting at PAGE_IDX to
+   POOL's free blocks, merging it with its buddy as long as the
+   buddy is free.  POOL's lock must be held. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+
+  ASSERT (page_idx % ((size_t) 1 << order) == 0);
+
+  pool->free_cnt += (size_t) 1 << order;
+  while (order < PAL_ORDERS - 1)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+      if (buddy >= page_cnt || pool->free_order[buddy] != order + 1)
+        break;
+      list_remove (block_elem (pool, buddy));
+      pool->free_order[buddy] = 0;
+      page_idx &= ~((size_t) 1 << order);
+      order++;
+    }
+  pool->free_order[page_idx] = order + 1;
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+}
+
+/* Frees the PAGE_CNT pages in POOL starting at PAGE_IDX, by
+   breaking them into the largest aligned blocks that fit.
+   POOL's lock must be held. */
+static void
+free_pages (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+
+      while (order < PAL_ORDERS - 1
+             && page_idx % ((size_t) 2 << order) == 0
+             && page_cnt >= (size_t) 2 << order)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Returns the list element stored in the first page of the free
+   block at PAGE_IDX in POOL. */
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + page_idx * PGSIZE);
+}
+
+/* Removes a page from POOL's zeroed pages and returns it, or
+   returns a null pointer if there are none, counting the hit or
+   miss.  Sets *WAKE_ZEROER to true if the zeroer thread should
+   be woken up to zero more pages.  POOL's lock must be held. */
+static void *
+take_zeroed_page (struct pool *pool, bool *wake_zeroer)
+{
+  struct list_elem *e = NULL;
+
+  if (!list_empty (&pool->zero_list))
+    {
+      pool->zero_hits++;
+      pool->zero_cnt--;
+      e = list_pop_front (&pool->zero_list);
+      memset (e, 0, sizeof *e);
+    }
+  else
+    pool->zero_misses++;
+
+  /* Wake the zeroer once half of the zeroed pages are gone. */
+  if (pool->zeroer_waiting && pool->zero_cnt * 2 < pool->zero_max)
+    {
+      pool->zeroer_waiting = false;
+      *wake_zeroer = true;
+    }
+  return e;
+}
+
+/* Gives all of POOL's zeroed pages back to its free blocks.
+   Returns true if there were any, false otherwise.  POOL's lock
+   must be held. */
+static bool
+release_zeroed_pages (struct pool *pool)
+{
+  if (list_empty (&pool->zero_list))
+    return false;
+
+  while (!list_empty (&pool->zero_list))
+    {
+      struct list_elem *e = list_pop_front (&pool->zero_list);
+      size_t page_idx = pg_no (e) - pg_no (pool->base);
+
+      bitmap_reset (pool->used_map, page_idx);
+      free_block (pool, page_idx, 0);
+    }
+  pool->zero_cnt = 0;
+  return true;
+}
+
+/* Zeroes a free page of POOL and adds it to POOL's zeroed
+   pages.  Returns true if successful, false if POOL already has
+   enough zeroed pages or has no free page, in which case the
+   zeroer is marked as waiting for POOL. */
+static bool
+zero_page (struct pool *pool)
+{
+  enum intr_level old_level;
+  size_t page_idx = BITMAP_ERROR;
+  uint64_t start;
+  void *page;
+
+  old_level = spin_lock_irqsave (&pool->lock);
+  if (pool->zero_cnt < pool->zero_max && !pool->low)
+    page_idx = alloc_block (pool, 0);
+  if (page_idx == BITMAP_ERROR)
+    {
+      pool->zeroer_waiting = true;
+      spin_unlock_irqrestore (&pool->lock, old_level);
+      return false;
+    }
+  bitmap_mark (pool->used_map, page_idx);
+  spin_unlock_irqrestore (&pool->lock, old_level);
+
+  page = pool->base + PGSIZE * page_idx;
+  start = rdtsc ();
+  memset (page, 0, PGSIZE);
+
+  old_level = spin_lock_irqsave (&pool->lock);
+  pool->zeroed_cycles += rdtsc () - start;
+  pool->zeroed_cnt++;
+  list_push_back (&pool->zero_list, page);
+  pool->zero_cnt++;
+  spin_unlock_irqrestore (&pool->lock, old_level);
+  return true;
+}
+
+/* Zeroer thread.  Keeps each pool's zeroed pages topped up,
+   sleeping whenever there is nothing to do. */
+static void
+zeroer (void *aux UNUSED) 
+{
+  if (thread_mlfqs)
+    thread_set_nice (NICE_MAX);
+
+  for (;;)
+    {
+      bool kernel_done = !zero_page (&kernel_pool);
+      bool user_done = !zero_page (&user_pool);
+
+      if (kernel_done && user_done)
+        sema_down (&zeroer_sema);
+    }
+}
+
+/* Counts an allocation from POOL with the given FLAGS, which
+   succeeded if SUCCESS is true, with pages borrowed from the
+   other pool if BORROWED is true.  Returns true if POOL has just
+   fallen below its low watermark, in which case the caller must
+   call notify_low() after releasing POOL's lock.  POOL's lock
+   must be held. */
+static bool
+account (struct pool *pool, enum palloc_flags flags, bool success,
+         bool borrowed)
+{
+  if (success)
+    {
+      pool->allocs++;
+      if (borrowed)
+        pool->borrows++;
+      if (flags & PAL_ZERO)
+        pool->zero_allocs++;
+      if (flags & PAL_ASSERT)
+        pool->assert_allocs++;
+    }
+  else
+    pool->failures++;
+
+  return check_low (pool, !success);
+}
+
+/* Checks whether POOL has just fallen below its low watermark,
+   or just failed an allocation if FAILED is true.  If so, marks
+   it low and returns true, in which case the caller must call
+   notify_low() after releasing POOL's lock.  POOL's lock must be
+   held. */
+static bool
+check_low (struct pool *pool, bool failed)
+{
+  if (!pool->low && !pool->low_pending && low_wq != NULL
+      && (failed || pool->free_cnt + pool->zero_cnt < pool->low_water))
+    {
+      pool->low = pool->low_pending = true;
+      pool->low_events++;
+      return true;
+    }
+  return false;
+}
+
+/* Arranges for the low-memory handlers to run for POOL.  Does
+   not sleep, so it may be called from an interrupt handler or
+   with interrupts off. */
+static void
+notify_low (struct pool *pool)
+{
+  wq_submit_delayed (low_wq, &pool->low_work, run_low_handlers, pool, 1);
+}
+
+/* Work function that calls each low-memory handler for POOL_,
+   and for the other pool too if POOL_ has pages lent to it. */
+static void
+run_low_handlers (void *pool_)
+{
+  struct pool *pool = pool_;
+  enum intr_level old_level;
+  bool reclaim;
+
+  old_level = spin_lock_irqsave (&pool->lock);
+  pool->low_pending = false;
+  reclaim = pool->lent_cnt > 0;
+  if (reclaim)
+    pool->reclaims++;
+  spin_unlock_irqrestore (&pool->lock, old_level);
+
+  lock_acquire (&low_lock);
+  call_low_handlers (pool);
+  if (reclaim)
+    call_low_handlers (pool->other);
+  lock_release (&low_lock);
+}
+
+/* Calls each low-memory handler for POOL.  low_lock must be
+   held. */
+static void
+call_low_handlers (struct pool *pool)
+{
+  enum intr_level old_level;
+  struct list_elem *e;
+  size_t free_cnt;
+
+  old_level = spin_lock_irqsave (&pool->lock);
+  free_cnt = pool->free_cnt + pool->zero_cnt;
+  spin_unlock_irqrestore (&pool->lock, old_level);
+
+  for (e = list_begin (&low_handlers); e != list_end (&low_handlers);
+       e = list_next (e))
+    {
+      struct palloc_low_handler *h
+        = list_entry (e, struct palloc_low_handler, elem);
+      h->func (pool->flags, free_cnt, h->aux);
+    }
+}
+
+/* Stores statistics for POOL into STATS. */
+static void
+get_pool_stats (struct pool *pool, struct memstat_pool *stats)
+{
+  enum intr_level old_level;
+  int order;
+
+  old_level = spin_lock_irqsave (&pool->lock);
+  stats->page_cnt = bitmap_size (pool->used_map);
+  stats->free_cnt = pool->free_cnt;
+  stats->zeroed_cnt = pool->zero_cnt;
+  stats->largest_free = 0;
+  for (order = PAL_ORDERS - 1; order >= 0; order--)
+    if (!list_empty (&pool->free_lists[order]))
+      {
+        stats->largest_free = (size_t) 1 << order;
+        break;
+      }
+  stats->allocs = pool->allocs;
+  stats->zero_allocs = pool->zero_allocs;
+  stats->assert_allocs = pool->assert_allocs;
+  stats->failures = pool->failures;
+  stats->low_events = pool->low_events;
+  stats->lent_cnt = pool->lent_cnt;
+  stats->borrowed_cnt = 0;
+  stats->borrows = pool->borrows;
+  stats->reclaims = pool->reclaims;
+  spin_unlock_irqrestore (&pool->lock, old_level);
+}
@@ -1,6 +1,9 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <list.h>
+#include <memstat.h>
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -11,13 +14,38 @@ enum palloc_flags
     PAL_USER = 004              /* User page. */
   };
 
+/* Low-memory handler.  Called with the pool that is low on
+   memory, PAL_USER for the user pool or 0 for the kernel pool,
+   the number of pages still available in it, and the auxiliary
+   data given to palloc_register_low(). */
+typedef void palloc_low_func (enum palloc_flags pool, size_t free_cnt,
+                              void *aux);
+
+/* A registered low-memory handler. */
+struct palloc_low_handler
+  {
+    struct list_elem elem;      /* List element. */
+    palloc_low_func *func;      /* Handler function. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+  };
+
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
+/* Percentage of free memory to put in user pool. */
+extern int user_page_percent;
+
 void palloc_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_grow_multiple (void *, size_t page_cnt, size_t new_cnt);
+void palloc_start (void);
+void palloc_register_low (struct palloc_low_handler *, palloc_low_func *,
+                          void *aux);
+void palloc_unregister_low (struct palloc_low_handler *);
+void palloc_get_stats (struct memstat_pool[MEMSTAT_POOLS]);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,191 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* Sampling profiler.
+
+   Every profile_interval timer ticks, the timer interrupt
+   handler records where the CPU was: the interrupted program
+   counter followed, for kernel code, by up to PROFILE_DEPTH - 1
+   return addresses found by following frame pointers.  Each
+   distinct call chain is counted in a per-CPU hash table, so
+   that a long run takes no more memory than a short one.  At
+   shutdown, profile_dump() prints the tables, which
+   utils/profile symbolizes against kernel.o into flat and
+   call-graph profiles.
+
+   A sample taken in a function's prologue, before it has set up
+   its frame pointer, misses its immediate caller.  Samples in
+   user programs record only the program counter.
+
+   The tables are allocated from the page allocator, so ticks
+   before profile_init() are not sampled. */
+
+/* Number of program counters in a sample. */
+#define PROFILE_DEPTH 6
+
+/* A call chain and the number of samples that hit it.  pc[0] is
+   the interrupted program counter, pc[1] its caller, and so on,
+   ending early with a null pointer if the chain is shorter. */
+struct profile_rec
+  {
+    uint32_t count;             /* Number of samples. */
+    uintptr_t pc[PROFILE_DEPTH]; /* Call chain. */
+  };
+
+/* Pages per CPU for the hash table. */
+#define PROFILE_PAGES 16
+#define PROFILE_CNT (PROFILE_PAGES * PGSIZE / sizeof (struct profile_rec))
+
+/* Per-CPU hash table of samples, with linear probing.  It is
+   filled to at most 3/4 of PROFILE_CNT; after that, samples
+   with new call chains are counted as lost. */
+struct profile_table
+  {
+    struct profile_rec *recs;   /* PROFILE_CNT records. */
+    unsigned used;              /* Number of records in use. */
+    unsigned ticks;             /* Ticks since the last sample. */
+    uint64_t samples;           /* Number of samples taken. */
+    uint64_t lost;              /* Samples not recorded. */
+  };
+
+static struct profile_table tables[CPU_MAX];
+
+bool profile_enabled;
+int profile_interval = 1;
+
+static void walk_frames (const struct intr_frame *,
+                         uintptr_t pc[PROFILE_DEPTH]);
+
+/* Allocates the sample tables.  Must be called after the page
+   allocator is initialized.  Does nothing unless profiling is
+   enabled. */
+void
+profile_init (void)
+{
+  unsigned i;
+
+  if (!profile_enabled)
+    return;
+
+  if (profile_interval < 1)
+    profile_interval = 1;
+  for (i = 0; i < smp_cpu_cnt; i++)
+    tables[i].recs = palloc_get_multiple (PAL_ASSERT | PAL_ZERO,
+                                          PROFILE_PAGES);
+}
+
+/* Samples interrupted context F, if profile_interval ticks have
+   passed since the last sample.  Use profile_tick() instead of
+   calling this directly. */
+void
+profile_sample (const struct intr_frame *f)
+{
+  struct profile_table *t = &tables[cpu_id ()];
+  uintptr_t pc[PROFILE_DEPTH];
+  unsigned i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->recs == NULL || ++t->ticks < (unsigned) profile_interval)
+    return;
+  t->ticks = 0;
+  t->samples++;
+
+  walk_frames (f, pc);
+  for (i = hash_bytes (pc, sizeof pc) % PROFILE_CNT; ;
+       i = (i + 1) % PROFILE_CNT)
+    {
+      struct profile_rec *r = &t->recs[i];
+
+      if (r->count == 0)
+        {
+          if (t->used >= PROFILE_CNT / 4 * 3)
+            {
+              t->lost++;
+              return;
+            }
+          t->used++;
+          memcpy (r->pc, pc, sizeof pc);
+        }
+      else if (memcmp (r->pc, pc, sizeof pc))
+        continue;
+      r->count++;
+      return;
+    }
+}
+
+/* Prints the sample tables to the console, one line per
+   distinct call chain. */
+void
+profile_dump (void)
+{
+  unsigned i, j;
+
+  if (!profile_enabled || tables[0].recs == NULL)
+    return;
+
+  /* Printing takes timer interrupts of its own.  Stop sampling
+     so that the tables hold still while we walk them. */
+  profile_enabled = false;
+
+  printf ("profile: begin %u %d %d\n", cpu_cnt, profile_interval, TIMER_FREQ);
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct profile_table *t = &tables[i];
+
+      printf ("profile: samples %u %"PRIu64"\n", i, t->samples);
+      if (t->lost > 0)
+        printf ("profile: lost %u %"PRIu64"\n", i, t->lost);
+      for (j = 0; j < PROFILE_CNT; j++)
+        {
+          struct profile_rec *r = &t->recs[j];
+          int k;
+
+          if (r->count == 0)
+            continue;
+          printf ("profile: %u %"PRIu32, i, r->count);
+          for (k = 0; k < PROFILE_DEPTH && r->pc[k] != 0; k++)
+            printf (" %#"PRIxPTR, r->pc[k]);
+          printf ("\n");
+        }
+    }
+  printf ("profile: end\n");
+}
+
+/* Stores into PC the call chain of interrupted context F. */
+static void
+walk_frames (const struct intr_frame *f, uintptr_t pc[PROFILE_DEPTH])
+{
+  void **frame = (void **) f->ebp;
+  void *stack = pg_round_down (f);
+  int i = 0;
+
+  memset (pc, 0, sizeof *pc * PROFILE_DEPTH);
+  pc[i++] = (uintptr_t) f->eip;
+  if (f->cs != SEL_KCSEG)
+    return;
+
+  /* F is on the interrupted thread's kernel stack, and so are
+     its frames, each above the one it called. */
+  while (i < PROFILE_DEPTH
+         && (void *) frame > (void *) f
+         && pg_round_down (frame) == stack
+         && frame[1] != NULL)
+    {
+      pc[i++] = (uintptr_t) frame[1];
+      if ((void *) frame[0] <= (void *) frame)
+        break;
+      frame = frame[0];
+    }
+}
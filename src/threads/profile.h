@@ -0,0 +1,28 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+
+struct intr_frame;
+
+/* Set by the "-profile" kernel command-line option. */
+extern bool profile_enabled;
+
+/* Timer ticks between samples, set by "-profile=N". */
+extern int profile_interval;
+
+void profile_init (void);
+void profile_sample (const struct intr_frame *);
+void profile_dump (void);
+
+/* Called by the timer interrupt handler with the interrupted
+   context F.  Takes a sample every profile_interval ticks, if
+   profiling is enabled. */
+static inline void
+profile_tick (const struct intr_frame *f)
+{
+  if (profile_enabled)
+    profile_sample (f);
+}
+
+#endif /* threads/profile.h */
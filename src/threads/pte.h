@@ -51,7 +51,10 @@ static inline uintptr_t pd_no (const void *va) {
    |         Physical Address           |         Flags          |
    +------------------------------------+------------------------+
 
-   In a PDE, the physical address points to a page table.
+   In a PDE, the physical address points to a page table, or,
+   if PTE_PS is set, to a 4 MB "large page" that the PDE maps
+   directly, in which case the address must be a multiple of
+   4 MB.
    In a PTE, the physical address points to a data or code page.
    The important flags are listed below.
    When a PDE or PTE is not "present", the other flags are
@@ -64,8 +67,11 @@ static inline uintptr_t pd_no (const void *va) {
 #define PTE_P 0x1               /* 1=present, 0=not present. */
 #define PTE_W 0x2               /* 1=read/write, 0=read-only. */
 #define PTE_U 0x4               /* 1=user/kernel, 0=kernel only. */
+#define PTE_PWT 0x8             /* 1=write-through, 0=write-back. */
+#define PTE_PCD 0x10            /* 1=cache disabled, 0=cache enabled. */
 #define PTE_A 0x20              /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80             /* 1=4 MB page, 0=page table (PDEs only). */
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create (uint32_t *pt) {
@@ -77,9 +83,22 @@ static inline uint32_t pde_create (uint32_t *pt) {
    PDE, which must "present", points to. */
 static inline uint32_t *pde_get_pt (uint32_t pde) {
   ASSERT (pde & PTE_P);
+  ASSERT (!(pde & PTE_PS));
   return ptov (pde & PTE_ADDR);
 }
 
+/* Returns a PDE that maps the 4 MB starting at PAGE, which must
+   be aligned on a 4 MB boundary, as a single large page.
+   The page is readable.
+   If WRITABLE is true then it will be writable as well.
+   The page will be usable only by ring 0 code (the kernel).
+   Large pages work only once CR4.PSE is set.  See [IA32-v3a]
+   3.7.3 "Mixing 4-KByte and 4-MByte Pages". */
+static inline uint32_t pde_create_kernel_large (void *page, bool writable) {
+  ASSERT ((uintptr_t) page % PTSPAN == 0);
+  return vtop (page) | PTE_PS | PTE_P | (writable ? PTE_W : 0);
+}
+
 /* Returns a PTE that points to PAGE.
    The PTE's page is readable.
    If WRITABLE is true then it will be writable as well.
@@ -0,0 +1,340 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Object caches.
+
+   malloc() rounds each request up to a power of 2, which wastes
+   up to half of each block.  An object cache instead hands out
+   objects of a single size, packed tightly into "slabs" of one
+   page each, so that, for example, a 536-byte inode takes up
+   585 bytes of memory instead of 1,365.
+
+   Each slab begins with a header followed by an array that links
+   the free objects in the slab into a stack by index, and then by
+   the objects themselves.  Keeping the links outside the objects
+   means that a free object keeps its contents, so an optional
+   constructor runs once for each object, when its slab is
+   created, rather than on every allocation.
+
+   A cache keeps its slabs on three lists: "partial" for slabs
+   with both allocated and free objects, "full" for slabs with no
+   free objects, and "empty" for slabs with no allocated objects.
+   Objects are allocated from partial slabs first, so that slabs
+   fill up and empty slabs can be given back to the page
+   allocator.  A few empty slabs are kept to save reconstructing
+   their objects. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Number of empty slabs that a cache keeps. */
+#define EMPTY_MAX 1
+
+/* End of a slab's free list. */
+#define SLAB_NONE UINT16_MAX
+
+/* An object cache. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for reports. */
+    size_t size;                /* Object size, rounded up to alignment. */
+    size_t obj_cnt;             /* Objects per slab. */
+    size_t obj_ofs;             /* Offset of first object in slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+    struct spinlock lock;       /* Protects the rest. */
+    struct list partial;        /* Slabs with some objects free. */
+    struct list full;           /* Slabs with no objects free. */
+    struct list empty;          /* Slabs with all objects free. */
+    size_t empty_cnt;           /* Number of slabs in `empty'. */
+    size_t in_use;              /* Number of allocated objects. */
+    struct list_elem elem;      /* Element in `caches'. */
+  };
+
+/* Slab header, at the beginning of each slab's page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of the cache's lists. */
+    uint16_t in_use;            /* Number of allocated objects. */
+    uint16_t free;              /* First free object, or SLAB_NONE. */
+    uint16_t next[];            /* For each free object, the next one. */
+  };
+
+/* All object caches, for kmem_print_savings(). */
+static struct list caches;
+static struct lock caches_lock;
+
+static struct slab *new_slab (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+static void *slab_obj (struct kmem_cache *, struct slab *, size_t idx);
+
+/* Initializes the object cache allocator. */
+void
+kmem_init (void)
+{
+  list_init (&caches);
+  lock_init (&caches_lock);
+}
+
+/* Creates and returns a cache for objects of SIZE bytes, aligned
+   on ALIGN-byte boundaries, where ALIGN is a power of 2 or 0 for
+   the alignment of a pointer.  If CTOR is nonnull, it is called
+   on each object when its slab is created.  NAME is used in
+   reports and must remain valid for the cache's lifetime.
+   Returns a null pointer if memory is not available or if SIZE
+   is too big for a slab. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+                   kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+  size_t obj_cnt, obj_ofs;
+
+  ASSERT (name != NULL);
+  ASSERT (size > 0);
+  if (align == 0)
+    align = sizeof (void *);
+  ASSERT ((align & (align - 1)) == 0);
+
+  /* Fit as many objects as possible into a page, along with the
+     header and a free-list link for each object. */
+  size = ROUND_UP (size, align);
+  for (obj_cnt = PGSIZE / size; obj_cnt > 0; obj_cnt--)
+    {
+      obj_ofs = ROUND_UP (sizeof (struct slab) + obj_cnt * sizeof (uint16_t),
+                          align);
+      if (obj_ofs + obj_cnt * size <= PGSIZE)
+        break;
+    }
+  if (obj_cnt == 0)
+    return NULL;
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    return NULL;
+  c->name = name;
+  c->size = size;
+  c->obj_cnt = obj_cnt;
+  c->obj_ofs = obj_ofs;
+  c->ctor = ctor;
+  spin_init_named (&c->lock, "kmem cache");
+  list_init (&c->partial);
+  list_init (&c->full);
+  list_init (&c->empty);
+  c->empty_cnt = 0;
+  c->in_use = 0;
+
+  lock_acquire (&caches_lock);
+  list_push_back (&caches, &c->elem);
+  lock_release (&caches_lock);
+  return c;
+}
+
+/* Destroys cache C, which must have no allocated objects, and
+   gives its memory back to the page allocator. */
+void
+kmem_cache_destroy (struct kmem_cache *c)
+{
+  if (c == NULL)
+    return;
+
+  ASSERT (c->in_use == 0);
+  ASSERT (list_empty (&c->partial) && list_empty (&c->full));
+
+  lock_acquire (&caches_lock);
+  list_remove (&c->elem);
+  lock_release (&caches_lock);
+
+  while (!list_empty (&c->empty))
+    palloc_free_page (list_entry (list_pop_front (&c->empty),
+                                  struct slab, elem));
+  free (c);
+}
+
+/* Allocates and returns an object from cache C, or a null
+   pointer if memory is not available.  May be called from an
+   interrupt handler. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  enum intr_level old_level;
+  struct slab *s;
+  size_t idx;
+
+  ASSERT (c != NULL);
+
+  old_level = spin_lock_irqsave (&c->lock);
+  if (list_empty (&c->partial) && list_empty (&c->empty))
+    {
+      /* Create a slab without holding the lock, so that the
+         constructor runs with interrupts as the caller had
+         them. */
+      spin_unlock_irqrestore (&c->lock, old_level);
+      s = new_slab (c);
+      if (s == NULL)
+        return NULL;
+      old_level = spin_lock_irqsave (&c->lock);
+      list_push_front (&c->empty, &s->elem);
+      c->empty_cnt++;
+    }
+
+  /* Take an object from a partial slab, or else an empty one. */
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else
+    {
+      s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+      c->empty_cnt--;
+      list_push_front (&c->partial, &s->elem);
+    }
+  idx = s->free;
+  ASSERT (idx != SLAB_NONE);
+  s->free = s->next[idx];
+  c->in_use++;
+  if (++s->in_use == c->obj_cnt)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+  spin_unlock_irqrestore (&c->lock, old_level);
+
+  return slab_obj (c, s, idx);
+}
+
+/* Frees OBJ, which must have been allocated from cache C and
+   must be in its constructed state.  Does nothing if OBJ is a
+   null pointer. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s, *victim = NULL;
+  enum intr_level old_level;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (c, obj);
+  idx = ((uint8_t *) obj - (uint8_t *) s - c->obj_ofs) / c->size;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it has a constructed state to keep. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->size);
+#endif
+
+  old_level = spin_lock_irqsave (&c->lock);
+  ASSERT (s->in_use > 0);
+  s->next[idx] = s->free;
+  s->free = idx;
+  c->in_use--;
+  if (s->in_use-- == c->obj_cnt)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  if (s->in_use == 0)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->empty, &s->elem);
+      if (++c->empty_cnt > EMPTY_MAX)
+        {
+          victim = list_entry (list_pop_back (&c->empty), struct slab, elem);
+          c->empty_cnt--;
+        }
+    }
+  spin_unlock_irqrestore (&c->lock, old_level);
+
+  if (victim != NULL)
+    palloc_free_page (victim);
+}
+
+/* Prints, for each object cache, how much memory each object
+   takes compared with malloc(), and how much the objects
+   allocated so far save. */
+void
+kmem_print_savings (void)
+{
+  struct list_elem *e;
+  size_t saved = 0;
+
+  if (list_empty (&caches))
+    return;
+
+  printf ("Object caches:\n");
+  lock_acquire (&caches_lock);
+  for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      size_t slab_bytes = PGSIZE / c->obj_cnt;
+      size_t malloc_bytes = malloc_footprint (c->size);
+
+      printf ("  %s: %zu-byte objects take %zu bytes, %zu with malloc().\n",
+              c->name, c->size, slab_bytes, malloc_bytes);
+      if (malloc_bytes > slab_bytes)
+        saved += c->in_use * (malloc_bytes - slab_bytes);
+    }
+  lock_release (&caches_lock);
+  printf ("Object caches have saved %'zu bytes so far.\n", saved);
+}
+
+/* Allocates a page for a new slab for cache C, constructs its
+   objects, and returns it, or returns a null pointer if no page
+   is available. */
+static struct slab *
+new_slab (struct kmem_cache *c)
+{
+  struct slab *s = palloc_get_page (0);
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->in_use = 0;
+  s->free = 0;
+  for (i = 0; i < c->obj_cnt; i++)
+    {
+      s->next[i] = i + 1 < c->obj_cnt ? i + 1 : SLAB_NONE;
+      if (c->ctor != NULL)
+        c->ctor (slab_obj (c, s, i));
+    }
+  return s;
+}
+
+/* Returns the slab of cache C that contains OBJ. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c UNUSED, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT (pg_ofs (obj) >= c->obj_ofs);
+  ASSERT ((pg_ofs (obj) - c->obj_ofs) % c->size == 0);
+
+  return s;
+}
+
+/* Returns object IDX in slab S of cache C. */
+static void *
+slab_obj (struct kmem_cache *c, struct slab *s, size_t idx)
+{
+  ASSERT (idx < c->obj_cnt);
+  return (uint8_t *) s + c->obj_ofs + idx * c->size;
+}
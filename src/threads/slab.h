@@ -0,0 +1,19 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Initializes an object when its slab is created.  An object
+   must be in its constructed state whenever it is freed, so that
+   it can be handed out again without calling the constructor. */
+typedef void kmem_ctor_func (void *obj);
+
+void kmem_init (void);
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      size_t align, kmem_ctor_func *);
+void kmem_cache_destroy (struct kmem_cache *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_print_savings (void);
+
+#endif /* threads/slab.h */
@@ -0,0 +1,574 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#endif
+
+/* Multiprocessor support.
+
+   smp_init() reads the MP configuration table that the BIOS
+   leaves in memory to find the CPUs and their local APICs.  If
+   there is more than one CPU, smp_start() starts each
+   application processor (AP) in turn with the INIT-STARTUP IPI
+   sequence, which sets it running ap-start.S in real mode.  Each
+   AP switches to protected mode and paging, loads its idle
+   thread's stack, and enters ap_main().
+
+   Device interrupts still come from the PICs, which stay wired
+   to the bootstrap processor's local APIC in "virtual wire
+   mode", so all of them go to the bootstrap processor.  The I/O
+   APIC is not used and its inputs are masked.  Each AP gets its
+   timer ticks from its own local APIC timer, set to run at
+   TIMER_FREQ.  A CPU tells another to look at its run queue with
+   a reschedule IPI.
+
+   The kernel is made safe for several CPUs by a big kernel lock,
+   which a CPU holds whenever its interrupts are off (see
+   interrupt.c).  Only code that runs with interrupts on, above
+   all user programs, gains from the extra CPUs.
+
+   See [MP] for the MP configuration table and the start-up
+   sequence, and [IA32-v3a] chapter 8 "Advanced Programmable
+   Interrupt Controller (APIC)" for the local APIC. */
+
+unsigned smp_cpu_cnt = 1;
+unsigned smp_max_cpus = 1;
+
+/* MP floating pointer structure.  See [MP] 4.1. */
+struct mp_float
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of config table. */
+    uint8_t length;             /* Length in 16-byte units. */
+    uint8_t revision;           /* Specification revision. */
+    uint8_t checksum;           /* Makes all bytes sum to 0. */
+    uint8_t features[5];        /* Nonzero features[0]: default config. */
+  };
+
+/* MP configuration table header.  See [MP] 4.2. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Length of header and base entries. */
+    uint8_t revision;           /* Specification revision. */
+    uint8_t checksum;           /* Makes all bytes sum to 0. */
+    char oem[8];                /* OEM ID. */
+    char product[12];           /* Product ID. */
+    uint32_t oem_table;         /* Physical address of OEM table. */
+    uint16_t oem_size;          /* Size of OEM table. */
+    uint16_t entry_cnt;         /* Number of base entries. */
+    uint32_t lapic;             /* Physical address of local APICs. */
+    uint16_t ext_length;        /* Length of extended entries. */
+    uint8_t ext_checksum;       /* Checksum of extended entries. */
+    uint8_t reserved;
+  };
+
+/* MP configuration table entry types and sizes.  See [MP] 4.3. */
+#define MP_PROCESSOR 0          /* One per CPU, 20 bytes. */
+#define MP_BUS 1                /* One per bus, 8 bytes. */
+#define MP_IOAPIC 2             /* One per I/O APIC, 8 bytes. */
+#define MP_IOINTR 3             /* I/O interrupt assignment, 8 bytes. */
+#define MP_LINTR 4              /* Local interrupt assignment, 8 bytes. */
+
+/* Processor entry. */
+struct mp_processor
+  {
+    uint8_t type;               /* MP_PROCESSOR. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    uint8_t apic_version;       /* Local APIC version. */
+    uint8_t flags;              /* MP_ENABLED, MP_BSP. */
+    uint32_t signature;         /* CPU signature. */
+    uint32_t features;          /* CPUID feature flags. */
+    uint32_t reserved[2];
+  };
+
+/* I/O APIC entry. */
+struct mp_ioapic
+  {
+    uint8_t type;               /* MP_IOAPIC. */
+    uint8_t apic_id;            /* I/O APIC ID. */
+    uint8_t apic_version;       /* I/O APIC version. */
+    uint8_t flags;              /* MP_ENABLED. */
+    uint32_t addr;              /* Physical address of registers. */
+  };
+
+#define MP_ENABLED 0x01         /* Usable. */
+#define MP_BSP 0x02             /* Bootstrap processor. */
+
+/* Local APIC registers, as byte offsets. */
+#define LAPIC_ID 0x020          /* ID. */
+#define LAPIC_TPR 0x080         /* Task priority. */
+#define LAPIC_EOI 0x0b0         /* End of interrupt. */
+#define LAPIC_SVR 0x0f0         /* Spurious interrupt vector. */
+#define LAPIC_ESR 0x280         /* Error status. */
+#define LAPIC_ICRLO 0x300       /* Interrupt command, bits 0...31. */
+#define LAPIC_ICRHI 0x310       /* Interrupt command, bits 32...63. */
+#define LAPIC_TIMER 0x320       /* Local vector table: timer. */
+#define LAPIC_LINT0 0x350       /* Local vector table: LINT0 pin. */
+#define LAPIC_LINT1 0x360       /* Local vector table: LINT1 pin. */
+#define LAPIC_ERROR 0x370       /* Local vector table: error. */
+#define LAPIC_TICR 0x380        /* Timer initial count. */
+#define LAPIC_TCCR 0x390        /* Timer current count. */
+#define LAPIC_TDCR 0x3e0        /* Timer divide configuration. */
+
+/* Local APIC register bits. */
+#define LAPIC_ENABLE 0x00000100 /* SVR: APIC software enable. */
+#define LVT_EXTINT 0x00000700   /* LVT: deliver as from the PIC. */
+#define LVT_NMI 0x00000400      /* LVT: deliver as NMI. */
+#define LVT_MASKED 0x00010000   /* LVT: masked. */
+#define LVT_PERIODIC 0x00020000 /* LVT timer: periodic mode. */
+#define TDCR_DIV16 0x00000003   /* TDCR: divide bus clock by 16. */
+#define ICR_INIT 0x00000500     /* ICR: INIT IPI. */
+#define ICR_STARTUP 0x00000600  /* ICR: STARTUP IPI. */
+#define ICR_PENDING 0x00001000  /* ICR: delivery pending. */
+#define ICR_ASSERT 0x00004000   /* ICR: assert (vs. de-assert). */
+#define ICR_LEVEL 0x00008000    /* ICR: level (vs. edge) triggered. */
+
+/* I/O APIC registers, selected through IOREGSEL and accessed
+   through IOWIN.  See [82093AA]. */
+#define IOAPIC_REGSEL 0x00      /* Register select, byte offset. */
+#define IOAPIC_WIN 0x10         /* Register window, byte offset. */
+#define IOAPIC_VER 0x01         /* Version and redirection entries. */
+#define IOAPIC_REDTBL 0x10      /* Redirection table, 2 per input. */
+
+/* Virtual address at which the local APIC's and the I/O APIC's
+   registers are mapped: the last 4 MB of the address space, far
+   above the kernel's mapping of RAM. */
+#define APIC_VADDR 0xffc00000
+
+/* Number of timer ticks over which to time the local APIC
+   timer. */
+#define CALIBRATE_TICKS 10
+
+static volatile uint32_t *lapic;        /* Local APIC registers. */
+static volatile uint32_t *ioapic;       /* I/O APIC registers. */
+static uint8_t apic_ids[CPU_MAX];       /* Each CPU's local APIC ID. */
+static uint32_t lapic_ticks;            /* Timer counts per tick. */
+
+/* Start-up code and its variables, in ap-start.S. */
+extern char ap_start[], ap_end[];
+extern uint32_t ap_cr3, ap_cr4, ap_esp;
+
+void ap_main (void) NO_RETURN;
+
+static struct mp_float *mp_search (void);
+static struct mp_float *mp_search_range (uintptr_t paddr, size_t size);
+static uint8_t checksum (const void *, size_t);
+static volatile uint32_t *map_apic (uint32_t *pt, int idx, uint32_t paddr);
+static void lapic_init (bool bsp);
+static void lapic_calibrate (void);
+static uint32_t lapic_read (int reg);
+static void lapic_write (int reg, uint32_t value);
+static void lapic_ipi (unsigned cpu, uint32_t icr);
+static void ioapic_init (void);
+static bool start_ap (unsigned cpu);
+static uint32_t *ap_var (uint32_t *);
+static intr_handler_func lapic_timer_interrupt;
+static intr_handler_func reschedule_interrupt;
+
+/* Finds the CPUs in the MP configuration table and maps the
+   APICs' registers.  Leaves smp_cpu_cnt at 1, so that the APICs
+   are never touched, if there is only one CPU, if the table is
+   missing or unusable, or if -smp=N with N > 1 was not given.  Must be called
+   after paging_init() and before any process page directory is
+   created. */
+void
+smp_init (void)
+{
+  struct mp_float *mp;
+  struct mp_config *conf;
+  uint32_t ioapic_paddr = 0;
+  unsigned cpu_limit = smp_max_cpus < CPU_MAX ? smp_max_cpus : CPU_MAX;
+  unsigned cnt = 1;
+  uint8_t *p, *end;
+  uint32_t *pt;
+
+  if (cpu_limit < 2)
+    return;
+
+  /* Find the configuration table.  Default configurations,
+     which have none, are not supported. */
+  mp = mp_search ();
+  if (mp == NULL || mp->features[0] != 0 || mp->config == 0
+      || mp->config + sizeof *conf > ram_pages * PGSIZE)
+    return;
+  conf = ptov (mp->config);
+  if (memcmp (conf->signature, "PCMP", 4)
+      || mp->config + conf->length > ram_pages * PGSIZE
+      || checksum (conf, conf->length) != 0)
+    return;
+
+  /* Take the APs in the order listed, after the bootstrap
+     processor, which is always CPU 0. */
+  p = (uint8_t *) (conf + 1);
+  end = (uint8_t *) conf + conf->length;
+  while (p < end)
+    switch (*p)
+      {
+      case MP_PROCESSOR:
+        {
+          struct mp_processor *proc = (struct mp_processor *) p;
+          if ((proc->flags & (MP_ENABLED | MP_BSP)) == MP_ENABLED
+              && cnt < cpu_limit)
+            apic_ids[cnt++] = proc->apic_id;
+          p += sizeof *proc;
+        }
+        break;
+
+      case MP_IOAPIC:
+        {
+          struct mp_ioapic *io = (struct mp_ioapic *) p;
+          if ((io->flags & MP_ENABLED) && ioapic_paddr == 0)
+            ioapic_paddr = io->addr;
+          p += sizeof *io;
+        }
+        break;
+
+      case MP_BUS:
+      case MP_IOINTR:
+      case MP_LINTR:
+        p += 8;
+        break;
+
+      default:
+        printf ("smp: unknown MP table entry type %d, "
+                "using one CPU\n", *p);
+        return;
+      }
+  if (cnt < 2)
+    return;
+
+  /* Map the registers, uncached. */
+  ASSERT (LOADER_PHYS_BASE + ram_pages * PGSIZE <= APIC_VADDR);
+  pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  base_page_dir[pd_no ((void *) APIC_VADDR)] = pde_create (pt);
+  lapic = map_apic (pt, 0, conf->lapic);
+  if (ioapic_paddr != 0)
+    ioapic = map_apic (pt, 1, ioapic_paddr);
+
+  apic_ids[0] = lapic_read (LAPIC_ID) >> 24;
+  smp_cpu_cnt = cnt;
+  printf ("smp: %u CPUs found\n", smp_cpu_cnt);
+}
+
+/* Starts the application processors found by smp_init().  Must
+   be called with interrupts on, after timer_calibrate(). */
+void
+smp_start (void)
+{
+  uint32_t cr4;
+  enum intr_level old_level;
+  unsigned i;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  if (smp_cpu_cnt < 2)
+    return;
+
+  intr_register_ext (LAPIC_VEC_TIMER, lapic_timer_interrupt,
+                     "Local APIC timer");
+  intr_register_ext (LAPIC_VEC_RESCHEDULE, reschedule_interrupt,
+                     "Reschedule IPI");
+
+  old_level = intr_disable ();
+  ioapic_init ();
+  lapic_init (true);
+  intr_set_level (old_level);
+  lapic_calibrate ();
+
+  /* Copy the start-up code to AP_START.  It runs there with
+     paging on before it jumps into the kernel, so map the bottom
+     4 MB of memory at virtual address 0 until every AP is up. */
+  memcpy (ptov (AP_START), ap_start, ap_end - ap_start);
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  *ap_var (&ap_cr3) = vtop (base_page_dir);
+  *ap_var (&ap_cr4) = cr4;
+  base_page_dir[0] = base_page_dir[pd_no (ptov (0))];
+
+  for (i = 1; i < smp_cpu_cnt; i++)
+    if (!start_ap (i))
+      break;
+
+  base_page_dir[0] = 0;
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (base_page_dir)) : "memory");
+  printf ("smp: %u CPUs started\n", cpu_cnt);
+}
+
+/* Sends a reschedule IPI to CPU, which makes it check whether a
+   thread on its run queue should preempt the one it is
+   running. */
+void
+smp_reschedule (unsigned cpu)
+{
+  ASSERT (cpu < cpu_cnt);
+  lapic_ipi (cpu, ICR_ASSERT | LAPIC_VEC_RESCHEDULE);
+}
+
+/* Signals the end of an interrupt from the running CPU's local
+   APIC. */
+void
+lapic_eoi (void)
+{
+  lapic_write (LAPIC_EOI, 0);
+}
+
+/* Entered by ap-start.S on an application processor, with
+   interrupts off and the stack of its idle thread, which
+   thread_create_idle() set up. */
+void
+ap_main (void)
+{
+  intr_init_ap ();
+#ifdef USERPROG
+  gdt_init_ap ();
+#endif
+  lapic_init (false);
+  thread_start_ap ();
+}
+
+/* Starts application processor CPU and waits for it to come
+   up.  Returns true if successful, false on failure.  See [MP]
+   B.4 "Application Processor Startup". */
+static bool
+start_ap (unsigned cpu)
+{
+  void *stack;
+  int64_t start;
+  int i;
+
+  stack = thread_create_idle (cpu);
+  if (stack == NULL)
+    return false;
+  *ap_var (&ap_esp) = (uint32_t) stack;
+
+  /* Point the warm reset vector at the start-up code, for
+     processors that start through the BIOS after INIT. */
+  outb (0x70, 0x0f);
+  outb (0x71, 0x0a);
+  *(uint16_t *) ptov (0x467) = 0;
+  *(uint16_t *) ptov (0x469) = AP_START >> 4;
+
+  lapic_ipi (cpu, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+  timer_usleep (200);
+  lapic_ipi (cpu, ICR_INIT | ICR_LEVEL);
+  timer_msleep (10);
+  for (i = 0; i < 2; i++)
+    {
+      lapic_ipi (cpu, ICR_STARTUP | (AP_START >> 12));
+      timer_usleep (200);
+    }
+
+  /* thread_start_ap() counts the new CPU in cpu_cnt. */
+  start = timer_ticks ();
+  while (*(volatile unsigned *) &cpu_cnt <= cpu)
+    {
+      if (timer_elapsed (start) > TIMER_FREQ)
+        {
+          printf ("smp: CPU %u (APIC ID %u) did not start\n",
+                  cpu, apic_ids[cpu]);
+          return false;
+        }
+      cpu_relax ();
+    }
+  return true;
+}
+
+/* Returns the address of VAR, one of the variables in
+   ap-start.S, in the copy at AP_START. */
+static uint32_t *
+ap_var (uint32_t *var)
+{
+  return (uint32_t *) ((uint8_t *) ptov (AP_START)
+                       + ((char *) var - ap_start));
+}
+
+/* Sets up the running CPU's local APIC.  The bootstrap processor
+   (BSP true) keeps taking device interrupts from the PICs on its
+   LINT0 pin, and timer ticks from the PIT.  An AP takes its timer
+   ticks from its local APIC timer. */
+static void
+lapic_init (bool bsp)
+{
+  lapic_write (LAPIC_SVR, LAPIC_ENABLE | LAPIC_VEC_SPURIOUS);
+  lapic_write (LAPIC_LINT0, bsp ? LVT_EXTINT : LVT_MASKED);
+  lapic_write (LAPIC_LINT1, bsp ? LVT_NMI : LVT_MASKED);
+  lapic_write (LAPIC_ERROR, LVT_MASKED);
+
+  /* Clear errors, which takes two writes, and any interrupt
+     left in service. */
+  lapic_write (LAPIC_ESR, 0);
+  lapic_write (LAPIC_ESR, 0);
+  lapic_write (LAPIC_EOI, 0);
+
+  /* Accept interrupts of every priority. */
+  lapic_write (LAPIC_TPR, 0);
+
+  lapic_write (LAPIC_TDCR, TDCR_DIV16);
+  if (bsp)
+    lapic_write (LAPIC_TIMER, LVT_MASKED);
+  else
+    {
+      lapic_write (LAPIC_TIMER, LVT_PERIODIC | LAPIC_VEC_TIMER);
+      lapic_write (LAPIC_TICR, lapic_ticks);
+    }
+}
+
+/* Sets lapic_ticks to the number of local APIC timer counts in
+   one timer tick, by counting down for CALIBRATE_TICKS ticks of
+   the PIT.  The bus clock that drives the timer is the same for
+   every CPU. */
+static void
+lapic_calibrate (void)
+{
+  int64_t start;
+
+  /* Wait for a timer tick. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    cpu_relax ();
+
+  lapic_write (LAPIC_TICR, 0xffffffff);
+  while (timer_elapsed (start) <= CALIBRATE_TICKS)
+    cpu_relax ();
+  lapic_ticks = (0xffffffff - lapic_read (LAPIC_TCCR)) / CALIBRATE_TICKS;
+  lapic_write (LAPIC_TICR, 0);
+}
+
+/* Returns the value of local APIC register REG. */
+static uint32_t
+lapic_read (int reg)
+{
+  return lapic[reg / 4];
+}
+
+/* Sets local APIC register REG to VALUE.  Reading back the ID
+   register waits for the write to complete. */
+static void
+lapic_write (int reg, uint32_t value)
+{
+  lapic[reg / 4] = value;
+  (void) lapic[LAPIC_ID / 4];
+}
+
+/* Sends an IPI described by ICR to CPU, and waits for the local
+   APIC to deliver it.  See [IA32-v3a] 8.6.1 "Interrupt Command
+   Register (ICR)". */
+static void
+lapic_ipi (unsigned cpu, uint32_t icr)
+{
+  enum intr_level old_level = intr_disable ();
+
+  lapic_write (LAPIC_ICRHI, (uint32_t) apic_ids[cpu] << 24);
+  lapic_write (LAPIC_ICRLO, icr);
+  while (lapic_read (LAPIC_ICRLO) & ICR_PENDING)
+    cpu_relax ();
+  intr_set_level (old_level);
+}
+
+/* Masks all of the I/O APIC's inputs.  The PICs deliver device
+   interrupts instead. */
+static void
+ioapic_init (void)
+{
+  int max, i;
+
+  if (ioapic == NULL)
+    return;
+
+  ioapic[IOAPIC_REGSEL / 4] = IOAPIC_VER;
+  max = (ioapic[IOAPIC_WIN / 4] >> 16) & 0xff;
+  for (i = 0; i <= max; i++)
+    {
+      ioapic[IOAPIC_REGSEL / 4] = IOAPIC_REDTBL + 2 * i;
+      ioapic[IOAPIC_WIN / 4] = LVT_MASKED | (0x20 + i);
+      ioapic[IOAPIC_REGSEL / 4] = IOAPIC_REDTBL + 2 * i + 1;
+      ioapic[IOAPIC_WIN / 4] = 0;
+    }
+}
+
+/* Maps the APIC registers at physical address PADDR at page IDX
+   of page table PT, which maps APIC_VADDR, and returns their
+   virtual address. */
+static volatile uint32_t *
+map_apic (uint32_t *pt, int idx, uint32_t paddr)
+{
+  pt[idx] = (paddr & PTE_ADDR) | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+  return (volatile uint32_t *) (APIC_VADDR + idx * PGSIZE
+                                + (paddr & PGMASK));
+}
+
+/* Looks for the MP floating pointer structure in the places
+   listed in [MP] 4 "MP Configuration Table": the first kB of the
+   Extended BIOS Data Area, the last kB of base memory, and the
+   BIOS ROM.  Returns it if found, otherwise a null pointer. */
+static struct mp_float *
+mp_search (void)
+{
+  uint16_t ebda = *(uint16_t *) ptov (0x40e);
+  uint16_t base_kb = *(uint16_t *) ptov (0x413);
+  struct mp_float *mp = NULL;
+
+  if (ebda != 0)
+    mp = mp_search_range ((uintptr_t) ebda << 4, 1024);
+  if (mp == NULL && base_kb != 0)
+    mp = mp_search_range (((uintptr_t) base_kb - 1) * 1024, 1024);
+  if (mp == NULL)
+    mp = mp_search_range (0xf0000, 0x10000);
+  return mp;
+}
+
+/* Looks for the MP floating pointer structure in the SIZE bytes
+   at physical address PADDR. */
+static struct mp_float *
+mp_search_range (uintptr_t paddr, size_t size)
+{
+  uint8_t *p = ptov (paddr);
+  uint8_t *end = p + size;
+
+  for (; p + sizeof (struct mp_float) <= end; p += 16)
+    if (!memcmp (p, "_MP_", 4) && checksum (p, sizeof (struct mp_float)) == 0)
+      return (struct mp_float *) p;
+  return NULL;
+}
+
+/* Returns the sum of the SIZE bytes at P, which is 0 for a valid
+   MP structure. */
+static uint8_t
+checksum (const void *p_, size_t size)
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *p++;
+  return sum;
+}
+
+/* Local APIC timer interrupt handler, for the APs. */
+static void
+lapic_timer_interrupt (struct intr_frame *args)
+{
+  profile_tick (args);
+  thread_tick ();
+}
+
+/* Reschedule IPI handler. */
+static void
+reschedule_interrupt (struct intr_frame *args UNUSED)
+{
+  thread_preempt ();
+}
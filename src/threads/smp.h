@@ -0,0 +1,24 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+#include <stdbool.h>
+
+/* Local APIC interrupt vectors.  See interrupt.h. */
+#define LAPIC_VEC_TIMER 0xf0            /* Local APIC timer tick. */
+#define LAPIC_VEC_RESCHEDULE 0xf1       /* Reschedule IPI. */
+#define LAPIC_VEC_SPURIOUS 0xff         /* Spurious interrupt. */
+
+/* Number of CPUs found by smp_init(), counting the bootstrap
+   processor.  Only the first cpu_cnt of them are running. */
+extern unsigned smp_cpu_cnt;
+
+/* -smp=N: Use at most N CPUs.  The default is 1, so that the
+   kernel runs on the bootstrap processor alone unless asked. */
+extern unsigned smp_max_cpus;
+
+void smp_init (void);
+void smp_start (void);
+void smp_reschedule (unsigned cpu);
+void lapic_eoi (void);
+
+#endif /* threads/smp.h */
@@ -29,10 +29,27 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
+#include "threads/lockdep.h"
+#ifdef LOCKSTAT
+#include "threads/lockstat.h"
+#endif
 #include "threads/thread.h"
+#include "threads/trace.h"
 
-static bool cond_priority_higher (const struct list_elem *e1, const struct list_elem *e2, void *aux UNUSED);
+static pheap_less_func sema_waiter_less;
+static pheap_less_func cond_waiter_less;
+static bool waits_before (int pri_a, unsigned seq_a, int pri_b, unsigned seq_b);
+static void donate_priority (struct thread *, struct lock *, int priority);
+static void donate_to_readers (struct rwlock *, int priority);
+static struct rwlock_hold *find_hold (struct thread *, const struct rwlock *);
+static void acquire_lock (struct lock *, uintptr_t site, bool check);
+static void acquire_spinlock (struct spinlock *, uintptr_t site);
+
+/* Arrival order of waiters.  Waiters of equal priority are woken
+   in the order in which they started waiting. */
+static unsigned wait_seq;
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -49,7 +66,7 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  pheap_init (&sema->waiters, sema_waiter_less, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -71,7 +88,12 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      struct thread *cur = thread_current ();
+
+      cur->wait_priority = cur->priority;
+      cur->wait_seq = wait_seq++;
+      cur->waiting_sema = sema;
+      pheap_insert (&sema->waiters, &cur->wait_elem);
       thread_block ();
     }
   sema->value--;
@@ -116,12 +138,13 @@ sema_up (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters))
-  {
-    struct list_elem *e = list_min (&sema->waiters, priority_higher, NULL);
-    list_remove (e);
-    thread_unblock (list_entry (e, struct thread, elem));
-  }
+  if (!pheap_empty (&sema->waiters))
+    {
+      struct thread *t = pheap_entry (pheap_pop_min (&sema->waiters),
+                                      struct thread, wait_elem);
+      t->waiting_sema = NULL;
+      thread_unblock (t);
+    }
   sema->value++;
   intr_set_level (old_level);
 
@@ -179,14 +202,22 @@ sema_test_helper (void *sema_)
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   CLASS is LOCK's class for lock-order checking and lock
+   statistics, or a null pointer. */
 void
-lock_init (struct lock *lock)
+lock_init_class (struct lock *lock, struct lock_class *class)
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->class = class;
+  lockdep_register (class);
+#ifdef LOCKSTAT
+  lockstat_register (class);
+#endif
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -199,44 +230,48 @@ lock_init (struct lock *lock)
    we need to sleep. */
 void
 lock_acquire (struct lock *lock)
+{
+  acquire_lock (lock, (uintptr_t) __builtin_return_address (0), true);
+}
+
+/* Acquires LOCK on behalf of the caller at address SITE, which
+   is reported by lock-order checking and recorded by lock
+   statistics if the wait is the longest.  Checks the lock order
+   first if CHECK is true; a caller that has already checked it
+   passes false. */
+static void
+acquire_lock (struct lock *lock, uintptr_t site UNUSED, bool check)
 {
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
+  if (check)
+    lockdep_check (lock->class, site);
 
   struct thread *cur = thread_current ();
   enum intr_level old_level = intr_disable ();
+#ifdef LOCKSTAT
+  bool contended = lock->holder != NULL;
+  uint64_t start = rdtsc ();
+#endif
 
   cur->waiting_lock = lock;
 
-  struct thread *donatee = lock->holder;
-  struct thread *donator = cur;
-  struct lock *inter_lock = lock;
-
-  while (donatee != NULL && donatee->priority < donator->priority) 
-  {
-    // donate priority
-    if (donatee->donator_lock == NULL)
-      donatee->ex_priority = donatee->priority;
-    donatee->donator_lock = inter_lock;
-    donatee->priority = donator->priority;
-
-    if (donatee->waiting_lock == NULL)
-      break;
-
-    inter_lock = donatee->waiting_lock;
-    donatee = inter_lock->holder;
-  }
+  /* The MLFQS does not use priority donation. */
+  if (!thread_mlfqs)
+    donate_priority (lock->holder, lock, cur->priority);
 
   sema_down (&lock->semaphore);
 
-
-  // there was a race issue here..
-  // If another thread try lock_acquire() before new holder sets lock->holder,
-  // priority donation can be skipped... -> now solved by intr_disable()
   lock->holder = cur;
   cur->waiting_lock = NULL;
   list_push_back (&cur->lock_list, &lock->elem);
+  lockdep_acquired (lock->class, site);
+#ifdef LOCKSTAT
+  lock->acquired_at = rdtsc ();
+  lockstat_acquired (lock->class, contended, lock->acquired_at - start,
+                     site);
+#endif
 
   intr_set_level (old_level);
 }
@@ -255,9 +290,20 @@ lock_try_acquire (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  enum intr_level old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock->holder = thread_current ();
+      list_push_back (&lock->holder->lock_list, &lock->elem);
+      lockdep_acquired (lock->class,
+                        (uintptr_t) __builtin_return_address (0));
+#ifdef LOCKSTAT
+      lock->acquired_at = rdtsc ();
+      lockstat_acquired (lock->class, false, 0, 0);
+#endif
+    }
+  intr_set_level (old_level);
   return success;
 }
 
@@ -276,6 +322,10 @@ lock_release (struct lock *lock)
   struct thread *cur = thread_current ();
   enum intr_level old_level = intr_disable ();
 
+  lockdep_release (lock->class);
+#ifdef LOCKSTAT
+  lockstat_released (lock->class, rdtsc () - lock->acquired_at);
+#endif
   lock->holder = NULL;
   list_remove (&lock->elem);
 
@@ -284,6 +334,7 @@ lock_release (struct lock *lock)
     cur->donator_lock = NULL;
     cur->priority = cur->ex_priority;
     get_donation (cur);
+    synch_priority_changed (cur);
   }
   sema_up (&lock->semaphore);
 
@@ -301,25 +352,478 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem 
-  {
-    struct list_elem elem;              /* List element. */
-    struct semaphore semaphore;         /* This semaphore. */
-    int priority;
-  };
+/* Initializes RW as a reader-writer lock held by nobody.
 
-static bool
-cond_priority_higher (const struct list_elem *e1, const struct list_elem *e2, void *aux UNUSED)
+   A writer holds RW's `lock' for as long as it holds RW.  A
+   reader holds `lock' only while it signs itself up as a reader.
+   So new readers must wait for a writer to finish, and a writer
+   that is waiting for the readers already inside to leave, which
+   it does while holding `lock', keeps new readers out.
+
+   A thread waiting for `lock' donates its priority to the holder
+   as usual.  A writer waiting for readers to leave donates its
+   priority to every reader, through `lock', and the donation
+   continues down whatever each of them is waiting for.
+
+   CLASS is RW's class for lock statistics, or a null pointer. */
+void
+rwlock_init_class (struct rwlock *rw, struct lock_class *class)
+{
+  ASSERT (rw != NULL);
+
+  lock_init_class (&rw->lock, class);
+  rw->reader_cnt = 0;
+  list_init (&rw->readers);
+  rw->waiting_writer = NULL;
+  sema_init (&rw->drained, 0);
+}
+
+/* Acquires RW for reading, sleeping until no writer holds or is
+   waiting for RW.  RW must not already be held by the current
+   thread, which may hold at most RWLOCK_HOLD_MAX reader-writer
+   locks for reading at once.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  struct rwlock_hold *hold;
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  hold = find_hold (cur, NULL);
+  if (hold == NULL)
+    PANIC ("thread holds too many reader-writer locks");
+
+  acquire_lock (&rw->lock, (uintptr_t) __builtin_return_address (0), true);
+  old_level = intr_disable ();
+  hold->rwlock = rw;
+  hold->thread = cur;
+  list_push_back (&rw->readers, &hold->elem);
+  rw->reader_cnt++;
+  intr_set_level (old_level);
+  lock_release (&rw->lock);
+  lockdep_acquired (rw->lock.class, (uintptr_t) __builtin_return_address (0));
+}
+
+/* Releases RW, which must be held for reading by the current
+   thread. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  struct rwlock_hold *hold;
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+
+  hold = find_hold (cur, rw);
+  ASSERT (hold != NULL);
+
+  old_level = intr_disable ();
+  lockdep_release (rw->lock.class);
+  list_remove (&hold->elem);
+  hold->rwlock = NULL;
+
+  if (cur->donator_lock == &rw->lock)
+    {
+      cur->donator_lock = NULL;
+      cur->priority = cur->ex_priority;
+      get_donation (cur);
+      synch_priority_changed (cur);
+    }
+
+  if (--rw->reader_cnt == 0 && rw->waiting_writer != NULL)
+    {
+      rw->waiting_writer = NULL;
+      sema_up (&rw->drained);
+    }
+  intr_set_level (old_level);
+
+  thread_preempt ();
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  RW must not already be held by the current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  acquire_lock (&rw->lock, (uintptr_t) __builtin_return_address (0), true);
+  old_level = intr_disable ();
+  if (rw->reader_cnt > 0)
+    {
+      rw->waiting_writer = cur;
+      cur->waiting_rwlock = rw;
+      if (!thread_mlfqs)
+        donate_to_readers (rw, cur->priority);
+      sema_down (&rw->drained);
+      cur->waiting_rwlock = NULL;
+    }
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which must be held for writing by the current
+   thread. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (lock_held_by_current_thread (&rw->lock));
+
+  lock_release (&rw->lock);
+}
+
+/* Turns the current thread's hold on RW for writing into a hold
+   for reading, without letting another writer in between.
+   Readers waiting for RW may then proceed, unless a writer is
+   ahead of them. */
+void
+rwlock_downgrade (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  struct rwlock_hold *hold;
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (lock_held_by_current_thread (&rw->lock));
+
+  hold = find_hold (cur, NULL);
+  if (hold == NULL)
+    PANIC ("thread holds too many reader-writer locks");
+
+  old_level = intr_disable ();
+  ASSERT (rw->reader_cnt == 0);
+  hold->rwlock = rw;
+  hold->thread = cur;
+  list_push_back (&rw->readers, &hold->elem);
+  rw->reader_cnt = 1;
+  intr_set_level (old_level);
+  lock_release (&rw->lock);
+  lockdep_acquired (rw->lock.class, (uintptr_t) __builtin_return_address (0));
+}
+
+/* Returns true if the current thread holds RW for reading or
+   writing, false otherwise. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return (lock_held_by_current_thread (&rw->lock)
+          || find_hold (thread_current (), rw) != NULL);
+}
+
+/* Returns T's hold on RW for reading, or, if RW is null, a free
+   hold slot.  Returns a null pointer if there is none. */
+static struct rwlock_hold *
+find_hold (struct thread *t, const struct rwlock *rw)
+{
+  int i;
+
+  for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+    if (t->rw_holds[i].rwlock == rw)
+      return &t->rw_holds[i];
+  return NULL;
+}
+
+/* Donates PRIORITY to DONATEE, which holds LOCK, and on to the
+   holder of each lock that DONATEE is waiting for in turn.  If
+   DONATEE is a writer waiting for the readers of a reader-writer
+   lock, the donation goes on to all of those readers.
+   Interrupts must be off. */
+static void
+donate_priority (struct thread *donatee, struct lock *lock, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (donatee != NULL && donatee->priority < priority)
+    {
+      if (donatee->donator_lock == NULL)
+        donatee->ex_priority = donatee->priority;
+      donatee->donator_lock = lock;
+      thread_change_priority (donatee, priority);
+      trace_event (TRACE_DONATE, donatee->tid, priority);
+
+      if (donatee->waiting_rwlock != NULL)
+        {
+          donate_to_readers (donatee->waiting_rwlock, priority);
+          break;
+        }
+      lock = donatee->waiting_lock;
+      if (lock == NULL)
+        break;
+      donatee = lock->holder;
+    }
+}
+
+/* Donates PRIORITY, from the writer waiting for RW, to each of
+   RW's readers.  Interrupts must be off. */
+static void
+donate_to_readers (struct rwlock *rw, int priority)
 {
-  struct semaphore_elem *se1 = list_entry (e1, struct semaphore_elem, elem);
-  struct semaphore_elem *se2 = list_entry (e2, struct semaphore_elem, elem);
+  struct list_elem *e;
 
-  ASSERT (se1 != NULL && se2 != NULL);
+  for (e = list_begin (&rw->readers); e != list_end (&rw->readers);
+       e = list_next (e))
+    {
+      struct rwlock_hold *hold = list_entry (e, struct rwlock_hold, elem);
+      donate_priority (hold->thread, &rw->lock, priority);
+    }
+}
+
+/* Initializes spinlock LOCK as unlocked.  CLASS is LOCK's class
+   for lock-order checking and lock statistics, or a null
+   pointer. */
+void
+spin_init_class (struct spinlock *lock, struct lock_class *class)
+{
+  ASSERT (lock != NULL);
+
+  lock->owner = lock->next = 0;
+  lock->cpu = -1;
+  lock->class = class;
+  lockdep_register (class);
+#ifdef LOCKSTAT
+  lockstat_register (class);
+#endif
+}
+
+/* Acquires LOCK, spinning until it becomes available.  The
+   caller must have turned interrupts off, and must not already
+   hold LOCK.
+
+   Waiters are served in the order in which they arrive: each
+   takes a ticket by atomically incrementing `next', then waits
+   for `owner' to reach it.  With interrupts off, a lock held by
+   our own CPU could never be released, so that is checked for. */
+void
+spin_lock (struct spinlock *lock)
+{
+  acquire_spinlock (lock, (uintptr_t) __builtin_return_address (0));
+}
+
+/* Acquires LOCK on behalf of the caller at address SITE, which
+   is reported by lock-order checking and recorded by lock
+   statistics if the wait is the longest. */
+static void
+acquire_spinlock (struct spinlock *lock, uintptr_t site UNUSED)
+{
+  uint16_t ticket = 1;
+#ifdef LOCKSTAT
+  uint64_t start = rdtsc ();
+  bool contended;
+#endif
 
-  return (se1->priority > se2->priority);
+  ASSERT (lock != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!spin_held_by_current_cpu (lock));
+  lockdep_check (lock->class, site);
+
+  asm volatile ("lock xaddw %0, %1"
+                : "+r" (ticket), "+m" (lock->next) : : "memory");
+#ifdef LOCKSTAT
+  contended = *(volatile uint16_t *) &lock->owner != ticket;
+#endif
+  while (*(volatile uint16_t *) &lock->owner != ticket)
+    cpu_relax ();
+  lock->cpu = cpu_id ();
+  lockdep_acquired (lock->class, site);
+#ifdef LOCKSTAT
+  lock->acquired_at = rdtsc ();
+  lockstat_acquired (lock->class, contended, lock->acquired_at - start,
+                     site);
+#endif
 }
 
+/* Tries to acquire LOCK without spinning and returns true if
+   successful or false if LOCK is held.  The caller must have
+   turned interrupts off. */
+bool
+spin_trylock (struct spinlock *lock)
+{
+  uint32_t expected, seen;
+
+  ASSERT (lock != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Take a ticket only if it would be served at once, that is,
+     if `next' equals `owner'.  The two counters are compared and
+     updated together as one 32-bit word, `owner' in the low half
+     and `next' in the high half. */
+  expected = *(volatile uint16_t *) &lock->owner;
+  expected |= expected << 16;
+  seen = expected;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "+a" (seen), "+m" (*(uint32_t *) lock)
+                : "r" (expected + 0x10000) : "memory");
+  if (seen != expected)
+    return false;
+  lock->cpu = cpu_id ();
+  lockdep_acquired (lock->class, (uintptr_t) __builtin_return_address (0));
+#ifdef LOCKSTAT
+  lock->acquired_at = rdtsc ();
+  lockstat_acquired (lock->class, false, 0, 0);
+#endif
+  return true;
+}
+
+/* Releases LOCK, which must be held by the current CPU. */
+void
+spin_unlock (struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+  ASSERT (spin_held_by_current_cpu (lock));
+
+  lockdep_release (lock->class);
+#ifdef LOCKSTAT
+  lockstat_released (lock->class, rdtsc () - lock->acquired_at);
+#endif
+  lock->cpu = -1;
+  barrier ();
+  *(volatile uint16_t *) &lock->owner = lock->owner + 1;
+}
+
+/* Turns interrupts off, acquires LOCK, and returns the previous
+   interrupt level, to be passed to spin_unlock_irqrestore().
+   May be called from an interrupt handler. */
+enum intr_level
+spin_lock_irqsave (struct spinlock *lock)
+{
+  enum intr_level old_level = intr_disable ();
+  acquire_spinlock (lock, (uintptr_t) __builtin_return_address (0));
+  return old_level;
+}
+
+/* Releases LOCK and restores interrupts to OLD_LEVEL. */
+void
+spin_unlock_irqrestore (struct spinlock *lock, enum intr_level old_level)
+{
+  spin_unlock (lock);
+  intr_set_level (old_level);
+}
+
+/* Returns true if LOCK is held by the CPU we are running on,
+   false otherwise. */
+bool
+spin_held_by_current_cpu (const struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+
+  return lock->cpu == (int) cpu_id ();
+}
+
+/* Maximum number of times mutex_lock() checks on a running
+   holder before going to sleep. */
+#define MUTEX_SPIN_MAX 1000
+
+/* Initializes MUTEX as unlocked.  CLASS is MUTEX's class for
+   lock statistics, or a null pointer. */
+void
+mutex_init_class (struct mutex *mutex, struct lock_class *class)
+{
+  ASSERT (mutex != NULL);
+
+  lock_init_class (&mutex->lock, class);
+}
+
+/* Acquires MUTEX, which must not already be held by the current
+   thread.
+
+   As long as the holder is running on another CPU, it will
+   probably release MUTEX soon, and spinning is cheaper than the
+   two context switches of sleeping and waking up.  Otherwise,
+   or if spinning goes on too long, we sleep in lock_acquire(),
+   which also donates our priority to the holder.  With a single
+   CPU the holder is never running while we are, so we never
+   spin.
+
+   The holder may exit and its page be reused while we look at
+   it.  The page stays mapped, so that at worst makes us spin
+   until MUTEX_SPIN_MAX runs out.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+mutex_lock (struct mutex *mutex)
+{
+  int spins;
+
+  ASSERT (mutex != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!mutex_held_by_current_thread (mutex));
+  lockdep_check (mutex->lock.class, (uintptr_t) __builtin_return_address (0));
+
+  for (spins = 0; spins < MUTEX_SPIN_MAX; spins++)
+    {
+      struct thread *holder = *(struct thread *volatile *) &mutex->lock.holder;
+      if (holder == NULL)
+        {
+          if (lock_try_acquire (&mutex->lock))
+            return;
+        }
+      else if (holder->status != THREAD_RUNNING)
+        break;
+      cpu_relax ();
+    }
+  acquire_lock (&mutex->lock, (uintptr_t) __builtin_return_address (0),
+                false);
+}
+
+/* Tries to acquire MUTEX without waiting and returns true if
+   successful or false on failure. */
+bool
+mutex_trylock (struct mutex *mutex)
+{
+  ASSERT (mutex != NULL);
+
+  return lock_try_acquire (&mutex->lock);
+}
+
+/* Releases MUTEX, which must be held by the current thread. */
+void
+mutex_unlock (struct mutex *mutex)
+{
+  ASSERT (mutex != NULL);
+
+  lock_release (&mutex->lock);
+}
+
+/* Returns true if the current thread holds MUTEX, false
+   otherwise. */
+bool
+mutex_held_by_current_thread (const struct mutex *mutex)
+{
+  ASSERT (mutex != NULL);
+
+  return lock_held_by_current_thread (&mutex->lock);
+}
+
+/* One semaphore in a condition variable's heap of waiters. */
+struct semaphore_elem 
+  {
+    struct pheap_elem elem;             /* Heap element. */
+    struct semaphore semaphore;         /* This semaphore. */
+    struct condition *cond;             /* Condition waited on. */
+    struct thread *thread;              /* Waiting thread. */
+    int priority;                       /* Waiter's priority when queued. */
+    unsigned seq;                       /* Arrival order, to break ties. */
+  };
+
 
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
@@ -329,7 +833,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  pheap_init (&cond->waiters, cond_waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -356,6 +860,8 @@ void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
   struct semaphore_elem waiter;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -363,9 +869,19 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  waiter.priority = thread_current ()->priority;
+  waiter.cond = cond;
+  waiter.thread = cur;
+
+  /* The heap is also modified by synch_priority_changed(), which
+     runs with interrupts off, so LOCK alone does not protect
+     it. */
+  old_level = intr_disable ();
+  waiter.priority = cur->priority;
+  waiter.seq = wait_seq++;
+  pheap_insert (&cond->waiters, &waiter.elem);
+  cur->cond_waiter = &waiter;
+  intr_set_level (old_level);
 
-  list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
@@ -386,12 +902,17 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters))
-  {
-    struct list_elem *e = list_min (&cond->waiters, cond_priority_higher, NULL);
-    list_remove (e);
-    sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
-  }
+  if (!pheap_empty (&cond->waiters))
+    {
+      enum intr_level old_level = intr_disable ();
+      struct semaphore_elem *waiter
+        = pheap_entry (pheap_pop_min (&cond->waiters),
+                       struct semaphore_elem, elem);
+      waiter->thread->cond_waiter = NULL;
+      intr_set_level (old_level);
+
+      sema_up (&waiter->semaphore);
+    }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -406,6 +927,63 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!pheap_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Called with interrupts off after thread T's priority changes.
+   If T is waiting on a semaphore or condition variable, moves it
+   to the position among the waiters that matches its new
+   priority, so that the highest-priority waiter is still the
+   one woken. */
+void
+synch_priority_changed (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->waiting_sema != NULL && t->wait_priority != t->priority)
+    {
+      t->wait_priority = t->priority;
+      pheap_update (&t->waiting_sema->waiters, &t->wait_elem);
+    }
+  if (t->cond_waiter != NULL && t->cond_waiter->priority != t->priority)
+    {
+      struct semaphore_elem *waiter = t->cond_waiter;
+      waiter->priority = t->priority;
+      pheap_update (&waiter->cond->waiters, &waiter->elem);
+    }
+}
+
+/* Returns true if a waiter with priority PRI_A that arrived at
+   SEQ_A should be woken before one with PRI_B that arrived at
+   SEQ_B. */
+static bool
+waits_before (int pri_a, unsigned seq_a, int pri_b, unsigned seq_b) 
+{
+  return pri_a > pri_b || (pri_a == pri_b && (int) (seq_a - seq_b) < 0);
+}
+
+/* Orders the threads waiting on a semaphore. */
+static bool
+sema_waiter_less (const struct pheap_elem *a_, const struct pheap_elem *b_,
+                  void *aux UNUSED) 
+{
+  const struct thread *a = pheap_entry (a_, struct thread, wait_elem);
+  const struct thread *b = pheap_entry (b_, struct thread, wait_elem);
+
+  return waits_before (a->wait_priority, a->wait_seq,
+                       b->wait_priority, b->wait_seq);
+}
+
+/* Orders the threads waiting on a condition variable. */
+static bool
+cond_waiter_less (const struct pheap_elem *a_, const struct pheap_elem *b_,
+                  void *aux UNUSED) 
+{
+  const struct semaphore_elem *a
+    = pheap_entry (a_, struct semaphore_elem, elem);
+  const struct semaphore_elem *b
+    = pheap_entry (b_, struct semaphore_elem, elem);
+
+  return waits_before (a->priority, a->seq, b->priority, b->seq);
+}
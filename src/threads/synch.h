@@ -2,13 +2,50 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <pheap.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+struct thread;
+
+/* A class of locks.  All the locks initialized by one call to
+   lock_init() or the like, however many times it runs, form a
+   class.  Lock-order checking (lockdep.c) and lock statistics
+   (lockstat.c) work in terms of classes. */
+struct lock_class
+  {
+    const char *name;           /* Name given at initialization. */
+    const char *file;           /* Source file of initialization. */
+    int line;                   /* Source line of initialization. */
+    int id;                     /* Index for lock-order checking, or 0. */
+#ifdef LOCKSTAT
+    struct lock_class *next;    /* Next class with statistics. */
+    bool registered;            /* On the list of classes yet? */
+
+    /* Statistics.  Times are in time-stamp counter cycles. */
+    uint64_t acquired;          /* Number of acquisitions. */
+    uint64_t contended;         /* Acquisitions that had to wait. */
+    uint64_t wait_total;        /* Total time spent waiting. */
+    uint64_t wait_max;          /* Longest wait. */
+    uintptr_t wait_max_site;    /* Caller that waited longest. */
+    uint64_t hold_total;        /* Total time held. */
+    uint64_t hold_max;          /* Longest hold. */
+#endif
+  };
+
+/* Returns a pointer to a lock class named NAME that is unique to
+   the call site. */
+#define LOCK_CLASS(NAME)                                        \
+        ({ static struct lock_class lock_class_ =               \
+             { .name = (NAME), .file = __FILE__, .line = __LINE__ }; \
+           &lock_class_; })
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct pheap waiters;       /* Waiting threads, highest priority first. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -23,18 +60,116 @@ struct lock
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
     struct list_elem elem;      /* List element for struct thread -> lock_list */
+    struct lock_class *class;   /* Class of locks. */
+#ifdef LOCKSTAT
+    uint64_t acquired_at;       /* Time-stamp counter when acquired. */
+#endif
   };
 
-void lock_init (struct lock *);
+/* Locks, mutexes, reader-writer locks and spinlocks are
+   initialized through macros, so that each call site names a
+   class of locks.  The plain forms name the class after the lock
+   expression, and the _named forms take a name.  Use these
+   rather than calling the *_init_class() functions directly. */
+#define lock_init(LOCK) lock_init_named (LOCK, #LOCK)
+#define lock_init_named(LOCK, NAME) lock_init_class (LOCK, LOCK_CLASS (NAME))
+
+void lock_init_class (struct lock *, struct lock_class *);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Reader-writer lock.  Can be held by any number of readers or
+   by a single writer.  A writer that is waiting keeps new readers
+   out, so that a stream of readers cannot starve it. */
+struct rwlock
+  {
+    struct lock lock;           /* Held by writer; readers pass through. */
+    int reader_cnt;             /* Number of threads holding for reading. */
+    struct list readers;        /* Each reader's struct rwlock_hold. */
+    struct thread *waiting_writer; /* Holder of LOCK waiting for readers. */
+    struct semaphore drained;   /* Upped when the last reader leaves. */
+  };
+
+/* Maximum number of reader-writer locks that a thread may hold
+   for reading at once. */
+#define RWLOCK_HOLD_MAX 4
+
+/* A thread's hold on a reader-writer lock for reading. */
+struct rwlock_hold
+  {
+    struct list_elem elem;      /* Element in rwlock's `readers'. */
+    struct rwlock *rwlock;      /* Lock held, or null if unused. */
+    struct thread *thread;      /* Thread holding it. */
+  };
+
+#define rwlock_init(RW) rwlock_init_named (RW, #RW)
+#define rwlock_init_named(RW, NAME) rwlock_init_class (RW, LOCK_CLASS (NAME))
+
+void rwlock_init_class (struct rwlock *, struct lock_class *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+void rwlock_downgrade (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+
+/* Ticket spinlock.
+
+   For short critical sections that must not sleep.  A spinlock
+   is held with interrupts off, so that its holder cannot be
+   preempted or interrupted by a handler that wants the same lock:
+   spin_lock() requires the caller to have turned interrupts off
+   already, and spin_lock_irqsave() turns them off itself.
+
+   With interrupts off, a CPU also holds the big kernel lock (see
+   interrupt.c), so for now no two CPUs are ever inside spinlocks
+   at the same time and a spinlock never actually spins. */
+struct spinlock
+  {
+    uint16_t owner;             /* Ticket now being served. */
+    uint16_t next;              /* Next ticket to hand out. */
+    int cpu;                    /* CPU holding lock, or -1 (for debugging). */
+    struct lock_class *class;   /* Class of locks. */
+#ifdef LOCKSTAT
+    uint64_t acquired_at;       /* Time-stamp counter when acquired. */
+#endif
+  };
+
+#define spin_init(LOCK) spin_init_named (LOCK, #LOCK)
+#define spin_init_named(LOCK, NAME) spin_init_class (LOCK, LOCK_CLASS (NAME))
+
+void spin_init_class (struct spinlock *, struct lock_class *);
+void spin_lock (struct spinlock *);
+bool spin_trylock (struct spinlock *);
+void spin_unlock (struct spinlock *);
+enum intr_level spin_lock_irqsave (struct spinlock *);
+void spin_unlock_irqrestore (struct spinlock *, enum intr_level);
+bool spin_held_by_current_cpu (const struct spinlock *);
+
+/* Adaptive mutex.  Like a lock, except that a thread that finds
+   the mutex held by a thread running on another CPU spins for a
+   while, expecting it to be released soon, before it sleeps. */
+struct mutex
+  {
+    struct lock lock;           /* Underlying lock. */
+  };
+
+#define mutex_init(MUTEX) mutex_init_named (MUTEX, #MUTEX)
+#define mutex_init_named(MUTEX, NAME) \
+        mutex_init_class (MUTEX, LOCK_CLASS (NAME))
+
+void mutex_init_class (struct mutex *, struct lock_class *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+bool mutex_held_by_current_thread (const struct mutex *);
+
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct pheap waiters;       /* Waiting threads, highest priority first. */
   };
 
 void cond_init (struct condition *);
@@ -42,6 +177,8 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+void synch_priority_changed (struct thread *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
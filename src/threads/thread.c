@@ -2,16 +2,21 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 #include <limits.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -25,12 +30,69 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+
+   There is one FIFO list per priority level.  Bit N of `bitmap'
+   is set if and only if lists[N] is nonempty, so the highest
+   priority with a ready thread can be found with a single bit
+   scan instead of a walk over every ready thread.
+
+   Ready threads in the deadline class are kept apart, on a
+   single list in order of absolute deadline, and always run
+   before any thread on the priority lists.
+
+   A run queue may only be changed with its lock held.  The
+   scheduler always runs with interrupts off, though, and so
+   under the big kernel lock (see interrupt.c), which already
+   serializes it across all the CPUs.  The run queue locks
+   therefore never contend; they only record which data the
+   big kernel lock is protecting here. */
+struct runqueue
+  {
+    struct spinlock lock;               /* Protects the run queue. */
+    struct list lists[PRI_MAX + 1];     /* Ready threads by priority. */
+    uint64_t bitmap;                    /* Nonempty lists. */
+    struct list dl;                     /* Deadline threads, earliest first. */
+    int dl_cnt;                         /* Number of threads in `dl'. */
+    int cnt;                            /* Number of ready threads. */
+  };
+
+/* Per-CPU scheduler state.
+
+   Each CPU schedules from its own run queue.  A thread goes
+   back on the run queue of the CPU it last ran on, and a CPU
+   whose run queue runs dry steals work from the busiest other
+   CPU before it goes idle.  A thread that wakes up while its CPU
+   is busy moves to an idle CPU, if there is one.  smp_start()
+   brings up the CPUs other than the bootstrap processor.
+   Everything here must be accessed with interrupts off, which
+   also means under the big kernel lock, so only one CPU at a
+   time is ever in the scheduler. */
+struct cpu
+  {
+    struct runqueue rq;                 /* Ready threads. */
+    struct thread *idle_thread;         /* Idle thread. */
+    struct thread *curr;                /* Running thread. */
+    int64_t ticks;                      /* # of timer ticks on this CPU. */
+    unsigned thread_ticks;              /* # of timer ticks since last yield. */
+    void *page_cache;                   /* Free thread pages. */
+    int page_cache_cnt;                 /* Number of pages in page_cache. */
+
+    /* Statistics. */
+    long long idle_ticks;               /* # of timer ticks spent idle. */
+    long long kernel_ticks;             /* # of timer ticks in kernel threads. */
+    long long user_ticks;               /* # of timer ticks in user programs. */
+  };
 
-/* Idle thread. */
-static struct thread *idle_thread;
+static struct cpu cpus[CPU_MAX];
+
+/* Number of CPUs in use. */
+unsigned cpu_cnt = 1;
+
+/* List of all processes.  Processes are added to this list
+   when they are created and removed when they exit. */
+static struct list all_list;
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -46,31 +108,83 @@ struct kernel_thread_frame
     void *aux;                  /* Auxiliary data for function. */
   };
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
-
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+
+/* Thread page cache.  Each CPU keeps the pages of threads that
+   have exited on a list, linked through each page's first word,
+   and reuses them for new threads.  This saves a trip through
+   the page allocator and the cost of clearing the whole page,
+   since only `struct thread' and the initial stack frames need
+   to be initialized.  When a cache fills, THREAD_CACHE_BATCH
+   pages at a time go back to the page allocator. */
+#define THREAD_CACHE_MAX 16     /* Maximum pages cached per CPU. */
+#define THREAD_CACHE_BATCH 8    /* Pages returned at once when full. */
+
+/* Deadline class bandwidth, in units of 1 / DL_BW_ONE of a CPU.
+   A thread with runtime R and deadline D uses R / D of a CPU,
+   rounded up, and deadline threads are admitted only as long as
+   their total stays at or below DL_BW_ONE.  Since D <= period,
+   this density test is sufficient for EDF to meet every
+   deadline.
+
+   The total is kept over all CPUs together.  A deadline thread
+   never migrates, so each CPU's share is at most the total and
+   every CPU passes the test, whatever CPU each thread is on.  It
+   also means that a thread's admission does not depend on which
+   CPU it happens to run on. */
+#define DL_BW_SHIFT 20
+#define DL_BW_ONE ((int64_t) 1 << DL_BW_SHIFT)
+
+/* Admitted deadline bandwidth.  Access with interrupts off. */
+static int64_t dl_bw;
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Multi-level feedback queue scheduler. */
+#define PRIORITY_FREQ 4         /* Recompute priorities every 4 ticks. */
+static fixed_t load_avg;        /* System load average. */
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void idle_loop (void) NO_RETURN;
 static struct thread *running_thread (void);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
+static int least_loaded_cpu (void);
 void schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct thread *);
+static struct cpu *this_cpu (void);
+static bool is_idle_thread (struct thread *);
+static bool cpu_is_idle (const struct cpu *);
+static struct cpu *wakeup_cpu (struct thread *);
+static struct cpu *busiest_cpu (const struct cpu *);
+static void resched_cpu (struct cpu *);
+static void rq_init (struct runqueue *);
+static void rq_push (struct runqueue *, struct thread *);
+static void rq_remove (struct runqueue *, struct thread *);
+static int rq_max_priority (const struct runqueue *);
+static struct thread *rq_pop (struct runqueue *);
+static struct thread *rq_pop_prio (struct runqueue *);
+static bool rq_preempts (struct runqueue *, struct thread *);
+static bool is_deadline_thread (const struct thread *);
+static bool deadline_earlier (const struct list_elem *,
+                              const struct list_elem *, void *);
+static int64_t dl_bandwidth (int64_t runtime, int64_t deadline);
+static void dl_leave (struct thread *);
+static void dl_replenish (void *t);
+static struct thread *steal_thread (struct cpu *);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_update_priority (struct thread *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -88,16 +202,21 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  unsigned i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = 0; i < CPU_MAX; i++)
+    rq_init (&cpus[i].rq);
+  list_init (&all_list);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
+  cpus[0].curr = initial_thread;
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -113,7 +232,8 @@ thread_start (void)
   /* Start preemptive thread scheduling. */
   intr_enable ();
 
-  /* Wait for the idle thread to initialize idle_thread. */
+  /* Wait for the idle thread to initialize this CPU's
+     idle_thread. */
   sema_down (&idle_started);
 }
 
@@ -123,19 +243,37 @@ void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
+  struct cpu *c = this_cpu ();
+
+  c->ticks++;
 
   /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
+  if (t == c->idle_thread)
+    c->idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
-    user_ticks++;
+    c->user_ticks++;
 #endif
   else
-    kernel_ticks++;
+    c->kernel_ticks++;
+
+  if (thread_mlfqs)
+    mlfqs_tick (t);
+
+  /* Enforce deadline runtime: a deadline thread that has used up
+     its budget is throttled until its next period. */
+  if (is_deadline_thread (t) && --t->dl_budget <= 0)
+    {
+      t->dl_throttled = true;
+      intr_yield_on_return ();
+    }
+
+  /* An idle CPU looks for work to steal at every tick. */
+  if (t == c->idle_thread && busiest_cpu (c) != NULL)
+    intr_yield_on_return ();
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++c->thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 }
 
@@ -143,6 +281,15 @@ thread_tick (void)
 void
 thread_print_stats (void) 
 {
+  long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++) 
+    {
+      idle_ticks += cpus[i].idle_ticks;
+      kernel_ticks += cpus[i].kernel_ticks;
+      user_ticks += cpus[i].user_ticks;
+    }
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
 }
@@ -175,13 +322,15 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = thread_page_get ();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
+  t->cpu = least_loaded_cpu ();
+  trace_thread_name (tid, name);
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -217,6 +366,7 @@ thread_block (void)
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
+  trace_event (TRACE_BLOCK, thread_current ()->tid, 0);
   thread_current ()->status = THREAD_BLOCKED;
   schedule ();
 }
@@ -228,18 +378,26 @@ thread_block (void)
    This function does not preempt the running thread.  This can
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
-   update other data. */
+   update other data.  If T goes on another CPU's run queue, that
+   CPU is asked to preempt its running thread if T should run in
+   its place. */
 void
 thread_unblock (struct thread *t) 
 {
+  struct cpu *c;
   enum intr_level old_level;
 
   ASSERT (is_thread (t));
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  trace_event (TRACE_UNBLOCK, t->tid, t->priority);
+  c = wakeup_cpu (t);
+  spin_lock (&c->rq.lock);
+  rq_push (&c->rq, t);
   t->status = THREAD_READY;
+  spin_unlock (&c->rq.lock);
+  resched_cpu (c);
   intr_set_level (old_level);
 }
 
@@ -290,6 +448,9 @@ thread_exit (void)
   /* Just set our status to dying and schedule another process.
      We will be destroyed during the call to schedule_tail(). */
   intr_disable ();
+  if (is_deadline_thread (thread_current ()))
+    dl_leave (thread_current ());
+  list_remove (&thread_current ()->allelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -306,38 +467,36 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (curr != idle_thread) 
-    list_push_back (&ready_list, &curr->elem);
-  curr->status = THREAD_READY;
+  if (curr->dl_throttled)
+    {
+      /* Out of budget.  dl_replenish() will unblock us. */
+      curr->status = THREAD_BLOCKED;
+    }
+  else
+    {
+      if (!is_idle_thread (curr)) 
+        {
+          struct runqueue *rq = &this_cpu ()->rq;
+          spin_lock (&rq->lock);
+          rq_push (rq, curr);
+          spin_unlock (&rq->lock);
+        }
+      curr->status = THREAD_READY;
+    }
   schedule ();
   intr_set_level (old_level);
 }
 
-bool
-priority_higher (const struct list_elem *e1, const struct list_elem *e2, void *aux UNUSED)
-{
-  struct thread *t1 = list_entry (e1, struct thread, elem);
-  struct thread *t2 = list_entry (e2, struct thread, elem);
-
-  ASSERT (t1 != NULL && t2 != NULL);
-
-  return (t1->priority > t2->priority);
-}
-
-struct list_elem *
-list_max_priority (const struct list *list)
-{
-  struct list_elem *e = list_min (list, priority_higher, NULL);
-  if (e == list_end (list))
-    return NULL;
-  return e;
-}
-
+/* Yields the CPU if a ready thread should run in place of the
+   running thread: a deadline thread with an earlier deadline, or
+   any deadline thread if the running thread is not one, or
+   failing that a thread with a higher priority.  In an external
+   interrupt context, the yield is deferred until the interrupt
+   returns. */
 void
-thread_preempt ()
+thread_preempt (void)
 {
-  struct list_elem *e = list_max_priority (&ready_list);
-  if (!list_empty (&ready_list) && list_entry (e, struct thread, elem)->priority > thread_current ()->priority)
+  if (rq_preempts (&this_cpu ()->rq, thread_current ()))
   {
     if (!intr_context ())
       thread_yield ();
@@ -348,7 +507,8 @@ thread_preempt ()
 
 /*
  * Get donation for donatee by looking all waiters
- * donatee is blocking.
+ * donatee is blocking, including writers waiting for it
+ * to release a reader-writer lock.
  *
  * donatee can be either donated or not.
  *
@@ -364,14 +524,16 @@ get_donation (struct thread *donatee)
   struct lock *lock;
   struct thread *t;
   struct list_elem *e;
+  int i;
 
   for (e = list_begin (&donatee->lock_list); e != list_end (&donatee->lock_list);
        e = list_next (e))
   {
     lock = list_entry (e, struct lock, elem);
-    if (!list_empty (&lock->semaphore.waiters))
+    if (!pheap_empty (&lock->semaphore.waiters))
     {
-      t = list_entry (list_max_priority (&lock->semaphore.waiters), struct thread, elem);
+      t = pheap_entry (pheap_min (&lock->semaphore.waiters),
+                       struct thread, wait_elem);
       ASSERT (is_thread (t));
 
       if (t->priority >= max_priority)
@@ -382,6 +544,22 @@ get_donation (struct thread *donatee)
     }
   }
 
+  /* A writer waiting for the readers of a reader-writer lock
+     donates to each of them. */
+  for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+  {
+    struct rwlock *rw = donatee->rw_holds[i].rwlock;
+    if (rw != NULL && rw->waiting_writer != NULL)
+    {
+      t = rw->waiting_writer;
+      if (t->priority >= max_priority)
+      {
+        max_priority = t->priority;
+        max_priority_lock = &rw->lock;
+      }
+    }
+  }
+
   if (max_priority > donatee->priority)
   {
     if (donatee->donator_lock == NULL)
@@ -397,6 +575,10 @@ thread_set_priority (int new_priority)
 {
   struct thread *cur = thread_current ();
 
+  /* The MLFQS computes priorities itself. */
+  if (thread_mlfqs)
+    return;
+
   /*
    * 1. not donated
    *    1) set priority
@@ -432,10 +614,36 @@ thread_set_priority (int new_priority)
    cur->priority = new_priority;
    get_donoation (cur);
    */
+  synch_priority_changed (cur);
   intr_set_level (old_level);
 
-  if (!list_empty (&ready_list) && list_entry (list_max_priority (&ready_list), struct thread, elem)->priority > cur->priority)
-    thread_yield ();
+  thread_preempt ();
+}
+
+/* Sets thread T's priority to PRIORITY.  If T is on the run
+   queue, it is moved to the tail of its new priority level.
+   Used when a priority is donated to a thread other than the
+   running thread.  Interrupts must be off. */
+void
+thread_change_priority (struct thread *t, int priority)
+{
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  if (t->status == THREAD_READY)
+    {
+      struct runqueue *rq = &cpus[t->cpu].rq;
+      spin_lock (&rq->lock);
+      rq_remove (rq, t);
+      t->priority = priority;
+      rq_push (rq, t);
+      spin_unlock (&rq->lock);
+      resched_cpu (&cpus[t->cpu]);
+    }
+  else
+    t->priority = priority;
+  synch_priority_changed (t);
 }
 
 /* Returns the current thread's priority. */
@@ -445,35 +653,237 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Puts the running thread in the deadline scheduling class.
+   From now on, in every PERIOD ticks it receives up to RUNTIME
+   ticks of CPU time, all within DEADLINE ticks of the start of
+   the period.  Requires 0 < RUNTIME <= DEADLINE <= PERIOD.  While
+   it has budget left, a deadline thread runs ahead of every
+   thread in the priority scheduler; deadline threads among
+   themselves run earliest deadline first.
+
+   A thread that finishes the work for a period should call
+   thread_deadline_yield().  A thread that runs out of budget is
+   throttled until its next period.
+
+   A RUNTIME of 0 returns the thread to the priority scheduler.
+
+   Returns false, changing nothing, if admitting the thread would
+   overcommit the deadline class. */
+bool
+thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int64_t bw, cur_bw;
+
+  ASSERT (runtime >= 0);
+  ASSERT (runtime == 0 || (runtime <= deadline && deadline <= period));
+
+  old_level = intr_disable ();
+  bw = runtime > 0 ? dl_bandwidth (runtime, deadline) : 0;
+  cur_bw = (is_deadline_thread (cur)
+            ? dl_bandwidth (cur->dl_runtime, cur->dl_deadline) : 0);
+  if (dl_bw - cur_bw + bw > DL_BW_ONE) 
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+
+  if (is_deadline_thread (cur))
+    dl_leave (cur);
+  if (runtime > 0) 
+    {
+      int64_t now = timer_ticks ();
+
+      cur->dl_runtime = runtime;
+      cur->dl_deadline = deadline;
+      cur->dl_period = period;
+      cur->dl_abs_deadline = now + deadline;
+      cur->dl_budget = runtime;
+      cur->dl_done = false;
+      cur->dl_misses = 0;
+      dl_bw += bw;
+      timer_alarm_init (&cur->dl_timer, dl_replenish, cur);
+      timer_alarm_set (&cur->dl_timer, now + period);
+    }
+  intr_set_level (old_level);
+
+  thread_preempt ();
+  return true;
+}
+
+/* Called by a deadline thread when it has finished its work for
+   the current period.  Gives up the rest of the period's budget
+   and sleeps until the next period starts. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_deadline_yield (void) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+  ASSERT (is_deadline_thread (cur));
+
+  old_level = intr_disable ();
+  if (timer_ticks () >= cur->dl_abs_deadline)
+    cur->dl_misses++;
+  cur->dl_done = true;
+  cur->dl_throttled = true;
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Returns the number of deadlines the current thread has missed
+   since it last called thread_set_deadline().  A period whose
+   work was not finished with thread_deadline_yield() by the time
+   the next period starts also counts as a miss. */
+int
+thread_get_deadline_misses (void) 
 {
-  /* Not yet implemented. */
+  return thread_current ()->dl_misses;
+}
+
+/* Sets the current thread's nice value to NICE and recalculates
+   its priority, yielding if it no longer has the highest
+   priority. */
+void
+thread_set_nice (int nice) 
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  else if (nice > NICE_MAX)
+    nice = NICE_MAX;
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    mlfqs_update_priority (cur);
+  intr_set_level (old_level);
+
+  thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load_avg_100 = fix_round (fix_mul_int (load_avg, 100));
+  intr_set_level (old_level);
+
+  return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu_100 = fix_round (fix_mul_int (thread_current ()->recent_cpu,
+                                               100));
+  intr_set_level (old_level);
+
+  return recent_cpu_100;
+}
+
+/* Returns the priority the MLFQS assigns to thread T, given its
+   recent_cpu and nice values. */
+static int
+mlfqs_priority (const struct thread *t) 
+{
+  int priority = fix_trunc (fix_sub (fix_int (PRI_MAX - t->nice * 2),
+                                     fix_div_int (t->recent_cpu, 4)));
+
+  if (priority < PRI_MIN)
+    return PRI_MIN;
+  else if (priority > PRI_MAX)
+    return PRI_MAX;
+  else
+    return priority;
+}
+
+/* Recomputes thread T's MLFQS priority, moving T to its new
+   level of the run queue if it is ready. */
+static void
+mlfqs_update_priority (struct thread *t) 
+{
+  int priority = mlfqs_priority (t);
+
+  if (priority != t->priority)
+    thread_change_priority (t, priority);
+}
+
+/* Does the MLFQS bookkeeping for a timer tick during which CUR
+   was running.
+
+   Between once-per-second updates, only the running thread's
+   recent_cpu changes, so it is the only thread whose priority
+   needs to be recomputed every PRIORITY_FREQ ticks.  This keeps
+   the cost of the timer interrupt independent of the number of
+   threads except once per second, when every thread's
+   recent_cpu decays. */
+static void
+mlfqs_tick (struct thread *cur) 
+{
+  struct cpu *c = this_cpu ();
+  bool bsp = c == &cpus[0];
+  int64_t ticks = bsp ? timer_ticks () : c->ticks;
+
+  if (!is_idle_thread (cur))
+    cur->recent_cpu = fix_add_int (cur->recent_cpu, 1);
+
+  /* Only the bootstrap processor takes the PIT's ticks, so it
+     does the once-per-second update for every CPU.  The others
+     count their own ticks. */
+  if (bsp && ticks % TIMER_FREQ == 0)
+    {
+      int ready_threads = 0;
+      fixed_t twice_load;
+      fixed_t decay;
+      struct list_elem *e;
+      unsigned i;
+
+      for (i = 0; i < cpu_cnt; i++)
+        {
+          ready_threads += cpus[i].rq.cnt;
+          if (cpus[i].curr != cpus[i].idle_thread)
+            ready_threads++;
+        }
+
+      load_avg = fix_add (fix_div_int (fix_mul_int (load_avg, 59), 60),
+                          fix_div_int (fix_int (ready_threads), 60));
+
+      twice_load = fix_mul_int (load_avg, 2);
+      decay = fix_div (twice_load, fix_add_int (twice_load, 1));
+
+      /* A thread with zero recent_cpu and zero niceness keeps
+         both its recent_cpu and its priority, so skip it. */
+      for (e = list_begin (&all_list); e != list_end (&all_list);
+           e = list_next (e))
+        {
+          struct thread *t = list_entry (e, struct thread, allelem);
+
+          if (is_idle_thread (t) || (t->recent_cpu == 0 && t->nice == 0))
+            continue;
+          t->recent_cpu = fix_add_int (fix_mul (decay, t->recent_cpu),
+                                       t->nice);
+          mlfqs_update_priority (t);
+        }
+    }
+  else if (ticks % PRIORITY_FREQ == 0 && !is_idle_thread (cur))
+    mlfqs_update_priority (cur);
+
+  thread_preempt ();
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -489,31 +899,71 @@ static void
 idle (void *idle_started_ UNUSED) 
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  this_cpu ()->idle_thread = thread_current ();
   sema_up (idle_started);
 
+  idle_loop ();
+}
+
+/* Runs the idle thread of the running CPU. */
+static void
+idle_loop (void) 
+{
   for (;;) 
     {
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
 
-      /* Re-enable interrupts and wait for the next one.
-
-         The `sti' instruction disables interrupts until the
-         completion of the next instruction, so these two
-         instructions are executed atomically.  This atomicity is
-         important; otherwise, an interrupt could be handled
-         between re-enabling interrupts and waiting for the next
-         one to occur, wasting as much as one clock tick worth of
-         time.
+      /* In tickless mode, don't let timer ticks wake us up
+         until one is needed. */
+      timer_idle_enter ();
 
-         See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-         7.11.1 "HLT Instruction". */
-      asm volatile ("sti; hlt" : : : "memory");
+      /* Re-enable interrupts and wait for the next one. */
+      intr_wait ();
     }
 }
 
+/* Creates the idle thread of CPU, an application processor about
+   to be started by smp_start(), and returns the top of its
+   stack, on which the CPU starts running.  Returns a null
+   pointer if no memory is available. */
+void *
+thread_create_idle (unsigned cpu) 
+{
+  struct thread *t;
+  char name[16];
+
+  ASSERT (cpu > 0 && cpu < CPU_MAX);
+
+  t = thread_page_get ();
+  if (t == NULL)
+    return NULL;
+
+  snprintf (name, sizeof name, "idle%u", cpu);
+  init_thread (t, name, PRI_MIN);
+  t->tid = allocate_tid ();
+  t->cpu = cpu;
+  t->status = THREAD_RUNNING;
+  trace_thread_name (t->tid, name);
+  cpus[cpu].idle_thread = cpus[cpu].curr = t;
+  return t->stack;
+}
+
+/* Called by an application processor, with interrupts off, once
+   it is ready to run threads.  Counts the CPU in cpu_cnt, so that
+   it takes part in scheduling, and runs its idle thread. */
+void
+thread_start_ap (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (running_thread () == this_cpu ()->idle_thread);
+  ASSERT (cpu_id () == cpu_cnt);
+
+  cpu_cnt++;
+  idle_loop ();
+}
+
 /* Function used as the basis for a kernel thread. */
 static void
 kernel_thread (thread_func *function, void *aux) 
@@ -525,7 +975,8 @@ kernel_thread (thread_func *function, void *aux)
   thread_exit ();       /* If function() returns, kill the thread. */
 }
 
-/* Returns the running thread. */
+/* Returns the running thread.  Each CPU runs on its running
+   thread's stack, so this works on any CPU. */
 struct thread *
 running_thread (void) 
 {
@@ -551,6 +1002,8 @@ is_thread (struct thread *t)
 static void
 init_thread (struct thread *t, const char *name, int priority)
 {
+  enum intr_level old_level;
+
   ASSERT (t != NULL);
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
@@ -564,11 +1017,27 @@ init_thread (struct thread *t, const char *name, int priority)
   list_init (&t->lock_list);
   t->ex_priority = priority;
 
+  /* A new thread inherits its parent's niceness and recent CPU
+     time. */
+  if (t != initial_thread)
+    {
+      struct thread *parent = thread_current ();
+      t->nice = parent->nice;
+      t->recent_cpu = parent->recent_cpu;
+    }
+  if (thread_mlfqs)
+    t->priority = t->ex_priority = mlfqs_priority (t);
+
   t->magic = THREAD_MAGIC;
+
+  old_level = intr_disable ();
+  list_push_back (&all_list, &t->allelem);
+  intr_set_level (old_level);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
-   returns a pointer to the frame's base. */
+   returns a pointer to the frame's base.  The frame is zeroed,
+   because the page may have belonged to another thread. */
 static void *
 alloc_frame (struct thread *t, size_t size) 
 {
@@ -577,25 +1046,356 @@ alloc_frame (struct thread *t, size_t size)
   ASSERT (size % sizeof (uint32_t) == 0);
 
   t->stack -= size;
+  memset (t->stack, 0, size);
   return t->stack;
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   return a thread from this CPU's run queue, unless the run queue
+   is empty.  (If the running thread can continue running, then it
+   will be in the run queue.)  If the run queue is empty, try to
+   steal a thread from another CPU, and failing that return this
+   CPU's idle thread. */
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
+  struct cpu *c = this_cpu ();
+  struct thread *t;
+
+  spin_lock (&c->rq.lock);
+  t = rq_pop (&c->rq);
+  spin_unlock (&c->rq.lock);
+  if (t == NULL)
+    t = steal_thread (c);
+  return t != NULL ? t : c->idle_thread;
+}
+
+/* Returns the index of the CPU we are running on, in the range
+   0...cpu_cnt - 1.  A thread's `cpu' changes only while the
+   thread is not running, so the running thread's is always
+   right. */
+unsigned
+cpu_id (void) 
+{
+  return running_thread ()->cpu;
+}
+
+/* Returns the running CPU's scheduler state. */
+static struct cpu *
+this_cpu (void) 
+{
+  return &cpus[cpu_id ()];
+}
+
+/* Returns true if T is the idle thread of some CPU. */
+static bool
+is_idle_thread (struct thread *t) 
+{
+  return t == cpus[t->cpu].idle_thread;
+}
+
+/* Returns true if C is running its idle thread and has no ready
+   threads. */
+static bool
+cpu_is_idle (const struct cpu *c) 
+{
+  return c->curr == c->idle_thread && c->rq.cnt == 0;
+}
+
+/* Returns the CPU on whose run queue T, which is waking up,
+   should go: the CPU it last ran on, unless that CPU is busy and
+   another is idle, in which case T moves to the idle CPU.
+   Deadline threads never move, because their bandwidth is
+   reserved on the CPU that admitted them. */
+static struct cpu *
+wakeup_cpu (struct thread *t) 
+{
+  struct cpu *c = &cpus[t->cpu];
+  unsigned i;
+
+  if (is_deadline_thread (t) || cpu_is_idle (c))
+    return c;
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpu_is_idle (&cpus[i]))
+      {
+        t->cpu = i;
+        return &cpus[i];
+      }
+  return c;
+}
+
+/* Sends C a reschedule IPI if it is not the running CPU and a
+   thread on its run queue should preempt the thread it is
+   running. */
+static void
+resched_cpu (struct cpu *c) 
+{
+  if (c != this_cpu () && rq_preempts (&c->rq, c->curr))
+    smp_reschedule (c - cpus);
+}
+
+/* Returns the index of the CPU with the fewest ready threads,
+   which is where a newly created thread is placed. */
+static int
+least_loaded_cpu (void) 
+{
+  unsigned best = 0;
+  unsigned i;
+
+  for (i = 1; i < cpu_cnt; i++)
+    if (cpus[i].rq.cnt < cpus[best].rq.cnt)
+      best = i;
+  return best;
+}
+
+/* Called when C's run queue is empty.  Takes the
+   highest-priority ready thread from the CPU with the most ready
+   threads and migrates it to C.  Returns the stolen thread, or a
+   null pointer if no other CPU has a thread to spare.
+
+   Deadline threads are never stolen, because their bandwidth is
+   reserved on the CPU that admitted them. */
+static struct thread *
+steal_thread (struct cpu *c) 
+{
+  struct cpu *busiest;
+  struct thread *t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  busiest = busiest_cpu (c);
+  if (busiest == NULL)
+    return NULL;
+
+  spin_lock (&busiest->rq.lock);
+  t = rq_pop_prio (&busiest->rq);
+  spin_unlock (&busiest->rq.lock);
+  if (t != NULL)
+    t->cpu = c - cpus;
+  return t;
+}
+
+/* Returns the CPU other than C with the most ready threads that
+   C could steal, or a null pointer if there is none. */
+static struct cpu *
+busiest_cpu (const struct cpu *c) 
+{
+  struct cpu *busiest = NULL;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (&cpus[i] != c && cpus[i].rq.bitmap != 0
+        && (busiest == NULL || cpus[i].rq.cnt > busiest->rq.cnt))
+      busiest = &cpus[i];
+  return busiest;
+}
+
+/* Initializes run queue RQ as empty. */
+static void
+rq_init (struct runqueue *rq) 
+{
+  int pri;
+
+  /* The scheduler takes run queue locks while switching threads,
+     when lock-order checking cannot tell which thread holds them,
+     so they have no lock class. */
+  spin_init_class (&rq->lock, NULL);
+  for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+    list_init (&rq->lists[pri]);
+  rq->bitmap = 0;
+  list_init (&rq->dl);
+  rq->dl_cnt = 0;
+  rq->cnt = 0;
+}
+
+/* Adds T to RQ: a deadline thread in deadline order, after any
+   with the same deadline, and any other thread at the tail of
+   the list for its priority. */
+static void
+rq_push (struct runqueue *rq, struct thread *t) 
+{
+  ASSERT (spin_held_by_current_cpu (&rq->lock));
+
+  if (is_deadline_thread (t)) 
+    {
+      list_insert_ordered (&rq->dl, &t->elem, deadline_earlier, NULL);
+      rq->dl_cnt++;
+    }
   else
-  {
-    struct list_elem *e = list_max_priority (&ready_list);
-    list_remove (e);
-    return list_entry (e, struct thread, elem);
-  }
+    {
+      list_push_back (&rq->lists[t->priority], &t->elem);
+      rq->bitmap |= (uint64_t) 1 << t->priority;
+    }
+  rq->cnt++;
+}
+
+/* Removes T from RQ. */
+static void
+rq_remove (struct runqueue *rq, struct thread *t) 
+{
+  ASSERT (spin_held_by_current_cpu (&rq->lock));
+
+  list_remove (&t->elem);
+  if (is_deadline_thread (t))
+    rq->dl_cnt--;
+  else if (list_empty (&rq->lists[t->priority]))
+    rq->bitmap &= ~((uint64_t) 1 << t->priority);
+  rq->cnt--;
+}
+
+/* Removes and returns the thread that should run next from RQ,
+   or a null pointer if RQ is empty. */
+static struct thread *
+rq_pop (struct runqueue *rq) 
+{
+  if (!list_empty (&rq->dl)) 
+    {
+      struct thread *t = list_entry (list_front (&rq->dl),
+                                     struct thread, elem);
+      rq_remove (rq, t);
+      return t;
+    }
+  return rq_pop_prio (rq);
+}
+
+/* Removes and returns the first thread of the highest priority
+   in RQ, ignoring deadline threads, or a null pointer if there
+   is none. */
+static struct thread *
+rq_pop_prio (struct runqueue *rq) 
+{
+  struct thread *t;
+
+  if (rq->bitmap == 0)
+    return NULL;
+
+  t = list_entry (list_front (&rq->lists[rq_max_priority (rq)]),
+                  struct thread, elem);
+  rq_remove (rq, t);
+  return t;
+}
+
+/* Returns the highest priority of any thread in RQ, or
+   PRI_MIN - 1 if RQ is empty.
+
+   The bit scan is done in two 32-bit halves because BSR
+   operates on at most 32 bits in protected mode.  See
+   [IA32-v2a] "BSR". */
+static int
+rq_max_priority (const struct runqueue *rq) 
+{
+  uint32_t hi = rq->bitmap >> 32;
+  uint32_t lo = rq->bitmap;
+  uint32_t idx;
+
+  if (hi != 0)
+    {
+      asm ("bsrl %1, %0" : "=r" (idx) : "rm" (hi));
+      return idx + 32;
+    }
+  else if (lo != 0)
+    {
+      asm ("bsrl %1, %0" : "=r" (idx) : "rm" (lo));
+      return idx;
+    }
+  else
+    return PRI_MIN - 1;
+}
+
+/* Returns true if RQ holds a thread that should run in place of
+   CUR.  Any thread should run in place of an idle thread. */
+static bool
+rq_preempts (struct runqueue *rq, struct thread *cur)
+{
+  if (is_idle_thread (cur))
+    return rq->cnt > 0;
+  if (!list_empty (&rq->dl))
+    {
+      struct thread *t = list_entry (list_front (&rq->dl),
+                                     struct thread, elem);
+      return (!is_deadline_thread (cur)
+              || t->dl_abs_deadline < cur->dl_abs_deadline);
+    }
+  return !is_deadline_thread (cur) && rq_max_priority (rq) > cur->priority;
+}
+
+/* Returns true if T is in the deadline scheduling class. */
+static bool
+is_deadline_thread (const struct thread *t)
+{
+  return t->dl_runtime > 0;
+}
+
+/* Returns true if the thread containing A has an earlier
+   absolute deadline than the one containing B. */
+static bool
+deadline_earlier (const struct list_elem *a, const struct list_elem *b,
+                  void *aux UNUSED)
+{
+  const struct thread *ta = list_entry (a, struct thread, elem);
+  const struct thread *tb = list_entry (b, struct thread, elem);
+
+  return ta->dl_abs_deadline < tb->dl_abs_deadline;
+}
+
+/* Returns the bandwidth used by a deadline thread with the given
+   RUNTIME and DEADLINE. */
+static int64_t
+dl_bandwidth (int64_t runtime, int64_t deadline)
+{
+  return DIV_ROUND_UP (runtime << DL_BW_SHIFT, deadline);
+}
+
+/* Takes running thread T out of the deadline class and releases
+   its bandwidth.  Interrupts must be off. */
+static void
+dl_leave (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (is_deadline_thread (t));
+
+  timer_alarm_cancel (&t->dl_timer);
+  dl_bw -= dl_bandwidth (t->dl_runtime, t->dl_deadline);
+  t->dl_runtime = 0;
+  t->dl_throttled = false;
+}
+
+/* Timer alarm that starts a new period for deadline thread T:
+   refills its budget, moves its deadline, and wakes it if it was
+   throttled.  Runs in an external interrupt context. */
+static void
+dl_replenish (void *t_)
+{
+  struct thread *t = t_;
+  int64_t start = t->dl_timer.expires;
+
+  if (!t->dl_done)
+    t->dl_misses++;
+  t->dl_done = false;
+  t->dl_budget = t->dl_runtime;
+
+  if (t->status == THREAD_READY)
+    {
+      struct runqueue *rq = &cpus[t->cpu].rq;
+      spin_lock (&rq->lock);
+      rq_remove (rq, t);
+      t->dl_abs_deadline = start + t->dl_deadline;
+      rq_push (rq, t);
+      spin_unlock (&rq->lock);
+      resched_cpu (&cpus[t->cpu]);
+    }
+  else
+    t->dl_abs_deadline = start + t->dl_deadline;
+
+  if (t->dl_throttled)
+    {
+      t->dl_throttled = false;
+      if (t->status == THREAD_BLOCKED)
+        thread_unblock (t);
+    }
+
+  timer_alarm_set (&t->dl_timer, start + t->dl_period);
+  thread_preempt ();
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -623,9 +1423,10 @@ schedule_tail (struct thread *prev)
 
   /* Mark us as running. */
   curr->status = THREAD_RUNNING;
+  this_cpu ()->curr = curr;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  this_cpu ()->thread_ticks = 0;
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -640,7 +1441,7 @@ schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != curr);
-      palloc_free_page (prev);
+      thread_page_put (prev);
     }
 }
 
@@ -663,10 +1464,70 @@ schedule (void)
   ASSERT (is_thread (next));
 
   if (curr != next)
-    prev = switch_threads (curr, next);
+    {
+      trace_event (TRACE_SWITCH_OUT, curr->tid, curr->status);
+      trace_event (TRACE_SWITCH_IN, next->tid, next->priority);
+      prev = switch_threads (curr, next);
+    }
   schedule_tail (prev); 
 }
 
+/* Returns a page for a new thread, taken from the running CPU's
+   page cache if possible, otherwise from the page allocator.  The
+   page's contents are arbitrary.  Returns a null pointer if no
+   page is available. */
+static struct thread *
+thread_page_get (void) 
+{
+  struct cpu *c;
+  void *page;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  c = this_cpu ();
+  page = c->page_cache;
+  if (page != NULL)
+    {
+      c->page_cache = *(void **) page;
+      c->page_cache_cnt--;
+    }
+  intr_set_level (old_level);
+
+  if (page == NULL)
+    page = palloc_get_page (0);
+  return page;
+}
+
+/* Adds dead thread T's page to the running CPU's page cache,
+   first returning a batch of pages to the page allocator if the
+   cache is full.  Interrupts must be off. */
+static void
+thread_page_put (struct thread *t) 
+{
+  struct cpu *c = this_cpu ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (c->page_cache_cnt >= THREAD_CACHE_MAX) 
+    {
+      int i;
+
+      for (i = 0; i < THREAD_CACHE_BATCH; i++) 
+        {
+          void *page = c->page_cache;
+          c->page_cache = *(void **) page;
+          palloc_free_page (page);
+        }
+      c->page_cache_cnt -= THREAD_CACHE_BATCH;
+    }
+
+  /* Keep is_thread() from accepting a stale pointer. */
+  t->magic = 0;
+  *(void **) t = c->page_cache;
+  c->page_cache = t;
+  c->page_cache_cnt++;
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) 
@@ -4,7 +4,10 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include <fixed-point.h>
+#include "threads/lockdep.h"
 #include "threads/synch.h"
+#include "devices/timer.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -25,6 +28,12 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, used by the multi-level feedback queue
+   scheduler. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -75,12 +84,11 @@ typedef int tid_t;
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+/* The `elem' member is the thread's element in the run queue
+   (thread.c).  A thread waiting on a semaphore is instead kept in
+   the semaphore's heap of waiters through `wait_elem' (synch.c),
+   so that it can be found again and moved when its priority
+   changes. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -89,17 +97,49 @@ struct thread
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
     int priority;                       /* Priority. */
-    int64_t awake_tick;                 /* Tick when it should be awaken */
+    int cpu;                            /* CPU it runs or is queued on. */
 
     /* attributes related with priority donation */
     struct lock *donator_lock; // NULL -> not donated
     struct lock *waiting_lock;
     struct list lock_list;
     int ex_priority;
+    struct rwlock *waiting_rwlock;      /* Writer waiting for readers. */
+    struct rwlock_hold rw_holds[RWLOCK_HOLD_MAX]; /* Read holds. */
+
+#ifndef NDEBUG
+    /* Owned by lockdep.c. */
+    struct lockdep_held lockdep_held[LOCKDEP_HELD_MAX]; /* Locks held. */
+    int lockdep_depth;                  /* Number of locks held. */
+#endif
+
+    /* Multi-level feedback queue scheduler state. */
+    int nice;                           /* Niceness. */
+    fixed_t recent_cpu;                 /* Recent CPU time received. */
+    struct list_elem allelem;           /* List element for all threads list. */
+
+    /* Deadline scheduling class, in timer ticks.  The thread
+       belongs to the class if dl_runtime is nonzero. */
+    int64_t dl_runtime;                 /* CPU time per period. */
+    int64_t dl_deadline;                /* Deadline, relative to period start. */
+    int64_t dl_period;                  /* Replenishment period. */
+    int64_t dl_abs_deadline;            /* Absolute deadline of current job. */
+    int64_t dl_budget;                  /* Runtime left in current period. */
+    bool dl_throttled;                  /* Waiting for replenishment? */
+    bool dl_done;                       /* Current job completed? */
+    int dl_misses;                      /* Number of missed deadlines. */
+    struct timer_alarm dl_timer;        /* Fires at each period start. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
 
+    /* Owned by synch.c. */
+    struct pheap_elem wait_elem;        /* Element in semaphore waiters. */
+    struct semaphore *waiting_sema;     /* Semaphore waited on, if any. */
+    struct semaphore_elem *cond_waiter; /* Condition wait, if any. */
+    int wait_priority;                  /* Priority when queued as waiter. */
+    unsigned wait_seq;                  /* Arrival order, to break ties. */
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
@@ -116,6 +156,8 @@ extern bool thread_mlfqs;
 
 void thread_init (void);
 void thread_start (void);
+void *thread_create_idle (unsigned cpu);
+void thread_start_ap (void) NO_RETURN;
 
 void thread_tick (void);
 void thread_print_stats (void);
@@ -141,7 +183,10 @@ void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
-bool priority_higher (const struct list_elem *, const struct list_elem *, void *);
-struct list_elem *list_max_priority (const struct list *list);
 void thread_preempt (void);
+void thread_change_priority (struct thread *, int priority);
+
+bool thread_set_deadline (int64_t runtime, int64_t deadline, int64_t period);
+void thread_deadline_yield (void);
+int thread_get_deadline_misses (void);
 #endif /* threads/thread.h */
@@ -0,0 +1,178 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/smp.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* Scheduler event tracing.
+
+   Each CPU has a ring buffer of fixed-size binary records that
+   is written with interrupts off, so recording an event never
+   takes a lock and is safe from interrupt handlers.  When a ring
+   fills up, the oldest records are overwritten.  At shutdown,
+   trace_dump() prints the rings in a line-oriented text format
+   that utils/trace2json converts into a Chrome trace (also
+   readable by Perfetto).
+
+   The rings are allocated from the page allocator, so events
+   that occur before trace_init() are dropped. */
+
+/* A trace record. */
+struct trace_rec
+  {
+    uint64_t tsc;               /* Time-stamp counter. */
+    int32_t tid;                /* Thread concerned. */
+    uint16_t arg;               /* Type-specific argument. */
+    uint8_t type;               /* A TRACE_* value. */
+    uint8_t pad;
+  };
+
+/* Pages per CPU for trace records. */
+#define TRACE_PAGES 16
+#define TRACE_CNT (TRACE_PAGES * PGSIZE / sizeof (struct trace_rec))
+
+/* Per-CPU ring of trace records. */
+struct trace_ring
+  {
+    struct trace_rec *recs;     /* TRACE_CNT records. */
+    uint64_t head;              /* Number of records ever written. */
+  };
+
+static struct trace_ring rings[CPU_MAX];
+
+/* Thread names, indexed by tid modulo TRACE_NAME_CNT.  A thread
+   whose slot is reused by a later thread loses its name. */
+struct trace_name
+  {
+    int tid;
+    char name[16];
+  };
+#define TRACE_NAME_CNT (PGSIZE / sizeof (struct trace_name))
+static struct trace_name *names;
+
+/* Time base for converting TSC values to time. */
+static uint64_t start_tsc;
+static int64_t start_ticks;
+
+/* Event names, as printed by trace_dump(). */
+static const char *type_names[TRACE_TYPE_CNT] =
+  {
+    "out", "in", "block", "unblock", "donate",
+    "sleep", "wake", "intr-enter", "intr-exit",
+  };
+
+bool trace_enabled;
+
+/* Allocates the trace buffers.  Must be called after the page
+   allocator is initialized.  Does nothing unless tracing is
+   enabled. */
+void
+trace_init (void)
+{
+  unsigned i;
+
+  if (!trace_enabled)
+    return;
+
+  for (i = 0; i < smp_cpu_cnt; i++)
+    rings[i].recs = palloc_get_multiple (PAL_ASSERT, TRACE_PAGES);
+  names = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  trace_thread_name (thread_tid (), thread_name ());
+  start_tsc = rdtsc ();
+  start_ticks = timer_ticks ();
+}
+
+/* Appends an event to the running CPU's ring.  Use
+   trace_event() instead of calling this directly. */
+void
+trace_record (enum trace_type type, int tid, int arg)
+{
+  struct trace_ring *ring;
+  struct trace_rec *r;
+  enum intr_level old_level;
+
+  ASSERT (type < TRACE_TYPE_CNT);
+
+  /* Find the ring with interrupts off, so that we cannot move
+     to another CPU before writing to it. */
+  old_level = intr_disable ();
+  ring = &rings[cpu_id ()];
+  if (ring->recs == NULL)
+    {
+      intr_set_level (old_level);
+      return;
+    }
+  r = &ring->recs[ring->head++ % TRACE_CNT];
+  r->tsc = rdtsc ();
+  r->tid = tid;
+  r->arg = arg;
+  r->type = type;
+  intr_set_level (old_level);
+}
+
+/* Remembers that thread TID is named NAME. */
+void
+trace_thread_name (int tid, const char *name)
+{
+  struct trace_name *n;
+  enum intr_level old_level;
+
+  if (names == NULL)
+    return;
+
+  old_level = intr_disable ();
+  n = &names[tid % TRACE_NAME_CNT];
+  n->tid = tid;
+  strlcpy (n->name, name, sizeof n->name);
+  intr_set_level (old_level);
+}
+
+/* Prints the contents of the trace buffers to the console, one
+   line per record, oldest first within each CPU. */
+void
+trace_dump (void)
+{
+  uint64_t cycles_per_sec = 0;
+  int64_t ticks;
+  unsigned i;
+
+  if (!trace_enabled || names == NULL)
+    return;
+
+  /* Printing causes events of its own.  Stop recording so that
+     the rings hold still while we walk them. */
+  trace_enabled = false;
+
+  ticks = timer_elapsed (start_ticks);
+  if (ticks > 0)
+    cycles_per_sec = (rdtsc () - start_tsc) / ticks * TIMER_FREQ;
+  printf ("trace: begin %u %"PRIu64"\n", cpu_cnt, cycles_per_sec);
+
+  for (i = 0; i < TRACE_NAME_CNT; i++)
+    if (names[i].tid != 0)
+      printf ("trace: name %d %s\n", names[i].tid, names[i].name);
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct trace_ring *ring = &rings[i];
+      uint64_t seq = ring->head > TRACE_CNT ? ring->head - TRACE_CNT : 0;
+
+      if (seq > 0)
+        printf ("trace: lost %u %"PRIu64"\n", i, seq);
+      for (; seq < ring->head; seq++)
+        {
+          struct trace_rec *r = &ring->recs[seq % TRACE_CNT];
+          printf ("trace: %u %"PRIu64" %s %d %u\n",
+                  i, r->tsc, type_names[r->type], (int) r->tid,
+                  (unsigned) r->arg);
+        }
+    }
+  printf ("trace: end\n");
+}
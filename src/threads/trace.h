@@ -0,0 +1,40 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Scheduler trace events. */
+enum trace_type
+  {
+    TRACE_SWITCH_OUT,           /* Thread stops running; arg = status. */
+    TRACE_SWITCH_IN,            /* Thread starts running; arg = priority. */
+    TRACE_BLOCK,                /* Thread blocks. */
+    TRACE_UNBLOCK,              /* Thread made ready; arg = priority. */
+    TRACE_DONATE,               /* Priority donated; arg = new priority. */
+    TRACE_SLEEP,                /* timer_sleep(); arg = ticks. */
+    TRACE_WAKE,                 /* Sleeping thread woken by the timer. */
+    TRACE_INTR_ENTER,           /* Interrupt entry; arg = vector. */
+    TRACE_INTR_EXIT,            /* Interrupt exit; arg = vector. */
+    TRACE_TYPE_CNT
+  };
+
+/* Set by the "-trace" kernel command-line option. */
+extern bool trace_enabled;
+
+void trace_init (void);
+void trace_record (enum trace_type, int tid, int arg);
+void trace_thread_name (int tid, const char *name);
+void trace_dump (void);
+
+/* Records an event of the given TYPE concerning thread TID, with
+   type-specific argument ARG, if tracing is enabled.  Callable
+   from any context, including interrupt handlers. */
+static inline void
+trace_event (enum trace_type type, int tid, int arg)
+{
+  if (trace_enabled)
+    trace_record (type, tid, arg);
+}
+
+#endif /* threads/trace.h */
@@ -0,0 +1,302 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Work queues.
+
+   A work queue is a pool of kernel threads that run work
+   functions handed to them with wq_submit().  Submitting work is
+   much cheaper than creating a thread for it, and it can be done
+   from an external interrupt handler.
+
+   Submitted work waits in a circular buffer, as in devices/intq.
+   The buffer is protected by turning interrupts off rather than
+   by a lock, so that interrupt handlers can add to it.  The
+   `work' semaphore counts the items in the buffer, and idle
+   workers sleep on it.  The `space' semaphore counts the free
+   slots, and a kernel thread that finds the buffer full sleeps
+   on it.  An interrupt handler cannot sleep, so it only gets
+   sema_try_down(). */
+
+/* Number of work items that can wait in a queue. */
+#define WQ_SIZE 64
+
+/* Sequence number of a worker that is not running any work. */
+#define WQ_IDLE UINT64_MAX
+
+/* A submitted work item. */
+struct wq_item
+  {
+    wq_func *func;              /* Work function, null to stop a worker. */
+    void *aux;                  /* Argument for FUNC. */
+  };
+
+/* A worker thread. */
+struct wq_worker
+  {
+    struct workqueue *wq;       /* Queue served. */
+    uint64_t seq;               /* Sequence number of item being run. */
+  };
+
+/* A work queue. */
+struct workqueue
+  {
+    /* Buffer, accessed with interrupts off.  Items are numbered
+       in order of submission.  Item N is in items[N % WQ_SIZE]. */
+    struct wq_item items[WQ_SIZE];
+    uint64_t head;              /* Number of items submitted. */
+    uint64_t tail;              /* Number of items taken by workers. */
+    struct semaphore work;      /* Items waiting in the buffer. */
+    struct semaphore space;     /* Free slots in the buffer. */
+
+    /* Workers. */
+    struct wq_worker *workers;  /* Array of worker state. */
+    int worker_cnt;             /* Number of workers. */
+    struct semaphore exited;    /* Upped by each worker on exit. */
+
+    /* wq_flush() support. */
+    struct lock flush_lock;     /* Protects flush_cnt and `flushed'. */
+    struct condition flushed;   /* Signaled when a worker finishes an item. */
+    int flush_cnt;              /* Number of threads in wq_flush(). */
+  };
+
+static thread_func worker_func;
+static void put_item (struct workqueue *, wq_func *, void *aux);
+static bool flushed_through (struct workqueue *, uint64_t seq);
+static timer_alarm_func delayed_func;
+
+/* Creates and returns a work queue served by NTHREADS worker
+   threads of the given PRIORITY.  Returns a null pointer if
+   memory or threads cannot be allocated. */
+struct workqueue *
+wq_create (int nthreads, int priority)
+{
+  struct workqueue *wq;
+  int i;
+
+  ASSERT (nthreads > 0);
+
+  wq = malloc (sizeof *wq);
+  if (wq == NULL)
+    return NULL;
+  wq->workers = malloc (sizeof *wq->workers * nthreads);
+  if (wq->workers == NULL)
+    {
+      free (wq);
+      return NULL;
+    }
+
+  wq->head = wq->tail = 0;
+  sema_init (&wq->work, 0);
+  sema_init (&wq->space, WQ_SIZE);
+  wq->worker_cnt = 0;
+  sema_init (&wq->exited, 0);
+  lock_init (&wq->flush_lock);
+  cond_init (&wq->flushed);
+  wq->flush_cnt = 0;
+
+  for (i = 0; i < nthreads; i++)
+    {
+      struct wq_worker *w = &wq->workers[i];
+      char name[24];
+
+      w->wq = wq;
+      w->seq = WQ_IDLE;
+      snprintf (name, sizeof name, "worker %d", i);
+      if (thread_create (name, priority, worker_func, w) == TID_ERROR)
+        break;
+      wq->worker_cnt++;
+    }
+  if (wq->worker_cnt < nthreads)
+    {
+      wq_destroy (wq);
+      return NULL;
+    }
+  return wq;
+}
+
+/* Waits for the work already submitted to WQ to finish, then
+   stops WQ's workers and frees WQ.  Work submitted to WQ after
+   this function is called, including delayed work that comes
+   due, is not allowed.  Must not be called from one of WQ's
+   workers. */
+void
+wq_destroy (struct workqueue *wq)
+{
+  int i;
+
+  ASSERT (!intr_context ());
+
+  for (i = 0; i < wq->worker_cnt; i++)
+    {
+      sema_down (&wq->space);
+      put_item (wq, NULL, NULL);
+    }
+  for (i = 0; i < wq->worker_cnt; i++)
+    sema_down (&wq->exited);
+  free (wq->workers);
+  free (wq);
+}
+
+/* Submits FUNC to WQ, to be called with AUX as its argument by
+   one of WQ's workers.  Returns true if successful.
+
+   From a kernel thread, waits for room if WQ's buffer is full,
+   and always succeeds.  From an external interrupt handler, which
+   cannot wait, returns false if the buffer is full. */
+bool
+wq_submit (struct workqueue *wq, wq_func *func, void *aux)
+{
+  ASSERT (func != NULL);
+
+  if (intr_context ())
+    {
+      if (!sema_try_down (&wq->space))
+        return false;
+    }
+  else
+    sema_down (&wq->space);
+
+  put_item (wq, func, aux);
+  return true;
+}
+
+/* Waits until all of the work submitted to WQ before the call
+   has finished running.  Delayed work counts as submitted only
+   once its delay expires.  Must not be called from one of WQ's
+   workers, which would wait for itself. */
+void
+wq_flush (struct workqueue *wq)
+{
+  enum intr_level old_level;
+  uint64_t seq;
+
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  seq = wq->head;
+  intr_set_level (old_level);
+
+  lock_acquire (&wq->flush_lock);
+  wq->flush_cnt++;
+  while (!flushed_through (wq, seq))
+    cond_wait (&wq->flushed, &wq->flush_lock);
+  wq->flush_cnt--;
+  lock_release (&wq->flush_lock);
+}
+
+/* Arranges for FUNC to be submitted to WQ, with AUX as its
+   argument, TICKS timer ticks from now.  DW must remain valid
+   until then or until wq_cancel_delayed() returns true for it.
+   May be called from an interrupt handler. */
+void
+wq_submit_delayed (struct workqueue *wq, struct wq_delayed *dw,
+                   wq_func *func, void *aux, int64_t ticks)
+{
+  ASSERT (func != NULL);
+
+  dw->wq = wq;
+  dw->func = func;
+  dw->aux = aux;
+  timer_alarm_init (&dw->alarm, delayed_func, dw);
+  timer_alarm_set (&dw->alarm, timer_ticks () + ticks);
+}
+
+/* Cancels delayed work DW.  Returns true if DW's delay had not
+   yet expired, false if its work has already been submitted. */
+bool
+wq_cancel_delayed (struct wq_delayed *dw)
+{
+  return timer_alarm_cancel (&dw->alarm);
+}
+
+/* Appends FUNC and AUX to WQ's buffer, which must have a free
+   slot reserved by downing `space'. */
+static void
+put_item (struct workqueue *wq, wq_func *func, void *aux)
+{
+  enum intr_level old_level;
+  struct wq_item *item;
+
+  old_level = intr_disable ();
+  ASSERT (wq->head - wq->tail < WQ_SIZE);
+  item = &wq->items[wq->head++ % WQ_SIZE];
+  item->func = func;
+  item->aux = aux;
+  intr_set_level (old_level);
+
+  sema_up (&wq->work);
+}
+
+/* Returns true if every item of WQ numbered below SEQ has
+   finished running. */
+static bool
+flushed_through (struct workqueue *wq, uint64_t seq)
+{
+  enum intr_level old_level;
+  bool done = true;
+  int i;
+
+  old_level = intr_disable ();
+  if (wq->tail < seq)
+    done = false;
+  for (i = 0; i < wq->worker_cnt && done; i++)
+    if (wq->workers[i].seq < seq)
+      done = false;
+  intr_set_level (old_level);
+
+  return done;
+}
+
+/* Worker thread: runs work items from W's queue until it takes
+   one with a null function. */
+static void
+worker_func (void *w_)
+{
+  struct wq_worker *w = w_;
+  struct workqueue *wq = w->wq;
+
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct wq_item item;
+
+      sema_down (&wq->work);
+      old_level = intr_disable ();
+      w->seq = wq->tail;
+      item = wq->items[wq->tail++ % WQ_SIZE];
+      intr_set_level (old_level);
+      sema_up (&wq->space);
+
+      if (item.func == NULL)
+        break;
+      item.func (item.aux);
+
+      old_level = intr_disable ();
+      w->seq = WQ_IDLE;
+      intr_set_level (old_level);
+
+      if (wq->flush_cnt > 0)
+        {
+          lock_acquire (&wq->flush_lock);
+          cond_broadcast (&wq->flushed, &wq->flush_lock);
+          lock_release (&wq->flush_lock);
+        }
+    }
+  sema_up (&wq->exited);
+}
+
+/* Alarm function for wq_submit_delayed().  Submits delayed work
+   DW_, or tries again on the next tick if the queue is full. */
+static void
+delayed_func (void *dw_)
+{
+  struct wq_delayed *dw = dw_;
+
+  if (!wq_submit (dw->wq, dw->func, dw->aux))
+    timer_alarm_set (&dw->alarm, timer_ticks () + 1);
+}
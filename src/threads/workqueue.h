@@ -0,0 +1,30 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+
+/* A work function. */
+typedef void wq_func (void *aux);
+
+/* Work deferred by a number of timer ticks.  Owned by the caller
+   of wq_submit_delayed(), which must keep it alive until the
+   work has been submitted or cancelled. */
+struct wq_delayed
+  {
+    struct timer_alarm alarm;   /* Fires when the delay expires. */
+    struct workqueue *wq;       /* Queue to submit to. */
+    wq_func *func;              /* Work function. */
+    void *aux;                  /* Argument for FUNC. */
+  };
+
+struct workqueue *wq_create (int nthreads, int priority);
+void wq_destroy (struct workqueue *);
+bool wq_submit (struct workqueue *, wq_func *, void *aux);
+void wq_flush (struct workqueue *);
+void wq_submit_delayed (struct workqueue *, struct wq_delayed *,
+                        wq_func *, void *aux, int64_t ticks);
+bool wq_cancel_delayed (struct wq_delayed *);
+
+#endif /* threads/workqueue.h */
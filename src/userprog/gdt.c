@@ -29,13 +29,14 @@ static uint64_t make_code_desc (int dpl);
 static uint64_t make_data_desc (int dpl);
 static uint64_t make_tss_desc (void *laddr);
 static uint64_t make_gdtr_operand (uint16_t limit, void *base);
+static void load_gdt (void);
 
 /* Sets up a proper GDT.  The bootstrap loader's GDT didn't
    include user-mode selectors or a TSS, but we need both now. */
 void
 gdt_init (void)
 {
-  uint64_t gdtr_operand;
+  unsigned i;
 
   /* Initialize GDT. */
   gdt[SEL_NULL / sizeof *gdt] = 0;
@@ -43,14 +44,33 @@ gdt_init (void)
   gdt[SEL_KDSEG / sizeof *gdt] = make_data_desc (0);
   gdt[SEL_UCSEG / sizeof *gdt] = make_code_desc (3);
   gdt[SEL_UDSEG / sizeof *gdt] = make_data_desc (3);
-  gdt[SEL_TSS / sizeof *gdt] = make_tss_desc (tss_get ());
+  for (i = 0; i < CPU_MAX; i++)
+    gdt[SEL_TSS_CPU (i) / sizeof *gdt] = make_tss_desc (tss_get (i));
+  load_gdt ();
+}
+
+/* Loads the GDT that gdt_init() set up on an application
+   processor, which starts out with a GDT like the bootstrap
+   loader's. */
+void
+gdt_init_ap (void)
+{
+  load_gdt ();
+}
+
+/* Loads the GDT into the running CPU, along with that CPU's
+   TSS. */
+static void
+load_gdt (void)
+{
+  uint64_t gdtr_operand;
 
   /* Load GDTR, TR.  See [IA32-v3a] 2.4.1 "Global Descriptor
      Table Register (GDTR)", 2.4.4 "Task Register (TR)", and
      6.2.4 "Task Register".  */
   gdtr_operand = make_gdtr_operand (sizeof gdt - 1, gdt);
   asm volatile ("lgdt %0" : : "m" (gdtr_operand));
-  asm volatile ("ltr %w0" : : "r" (SEL_TSS));
+  asm volatile ("ltr %w0" : : "r" (SEL_TSS_CPU (cpu_id ())));
 }
 
 /* System segment or code/data segment? */
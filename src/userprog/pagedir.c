@@ -12,7 +12,11 @@ static void invalidate_pagedir (uint32_t *);
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
    Returns the new page directory, or a null pointer if memory
-   allocation fails. */
+   allocation fails.
+
+   The kernel mappings are the PDEs copied from base_page_dir.
+   Some may map 4 MB pages directly (see paging_init()); the
+   others point to page tables that all page directories share. */
 uint32_t *
 pagedir_create (void) 
 {
@@ -136,6 +140,19 @@ pagedir_get_page (uint32_t *pd, const void *uaddr)
     return NULL;
 }
 
+/* Returns true if user virtual address UADDR is mapped writable
+   in PD, false if it is read-only or unmapped. */
+bool
+pagedir_is_writable (uint32_t *pd, const void *uaddr) 
+{
+  uint32_t *pte;
+
+  ASSERT (is_user_vaddr (uaddr));
+
+  pte = lookup_page (pd, uaddr, false);
+  return pte != NULL && (*pte & (PTE_P | PTE_W)) == (PTE_P | PTE_W);
+}
+
 /* Marks user virtual page UPAGE "not present" in page
    directory PD.  Later accesses to the page will fault.  Other
    bits in the page table entry are preserved.
@@ -1,10 +1,17 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
+#include "threads/memstat.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
 
 static void syscall_handler (struct intr_frame *);
+static bool copy_in (void *, const void *usrc, size_t);
+static bool copy_out (void *udst, const void *, size_t);
+static int sys_memstat (struct memstat *);
 
 void
 syscall_init (void) 
@@ -13,8 +20,93 @@ syscall_init (void)
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+syscall_handler (struct intr_frame *f) 
 {
+  uint32_t args[2];
+
+  /* Of the system calls, only memstat is implemented so far. */
+  if (copy_in (args, f->esp, sizeof args) && args[0] == SYS_MEMSTAT)
+    {
+      f->eax = sys_memstat ((struct memstat *) args[1]);
+      return;
+    }
+
   printf ("system call!\n");
   thread_exit ();
 }
+
+/* Memstat system call: stores memory usage statistics into
+   USTATS.  Returns true if successful, false if USTATS is not a
+   writable user buffer. */
+static int
+sys_memstat (struct memstat *ustats) 
+{
+  struct memstat stats;
+
+  memstat_get (&stats);
+  return copy_out (ustats, &stats, sizeof stats);
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns true if successful, false if any of the user
+   bytes is unmapped or in kernel space. */
+static bool
+copy_in (void *dst_, const void *usrc_, size_t size) 
+{
+  uint8_t *dst = dst_;
+  const uint8_t *usrc = usrc_;
+  uint32_t *pd = thread_current ()->pagedir;
+
+  for (; size > 0; size--, dst++, usrc++) 
+    {
+      const uint8_t *src;
+
+      if (!is_user_vaddr (usrc))
+        return false;
+      src = pagedir_get_page (pd, usrc);
+      if (src == NULL)
+        return false;
+      *dst = *src;
+    }
+  return true;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns true if successful, false if any of the user
+   bytes is unmapped, read-only, or in kernel space. */
+static bool
+copy_out (void *udst_, const void *src_, size_t size) 
+{
+  uint8_t *udst = udst_;
+  const uint8_t *src = src_;
+  uint32_t *pd = thread_current ()->pagedir;
+  uint8_t *upage;
+
+  if (size == 0)
+    return true;
+  if (!is_user_vaddr (udst)
+      || size > (size_t) ((uint8_t *) PHYS_BASE - udst))
+    return false;
+
+  /* Check every page first, so that a bad buffer is left
+     unmodified. */
+  for (upage = pg_round_down (udst); upage < udst + size; upage += PGSIZE)
+    if (!pagedir_is_writable (pd, upage))
+      return false;
+
+  /* Copy a page at a time.  We write through the kernel's
+     mapping of each page, so the CPU does not set the dirty bit
+     in the user's page table entry; set it ourselves. */
+  while (size > 0) 
+    {
+      size_t chunk = PGSIZE - pg_ofs (udst);
+      if (chunk > size)
+        chunk = size;
+      memcpy (pagedir_get_page (pd, udst), src, chunk);
+      pagedir_set_dirty (pd, udst, true);
+      udst += chunk;
+      src += chunk;
+      size -= chunk;
+    }
+  return true;
+}
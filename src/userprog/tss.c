@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -44,6 +45,9 @@
        stack pointer to point to the new thread's kernel stack.
        (The call is in schedule_tail() in thread.c.)
 
+   Each CPU runs a different thread, so each CPU has a TSS of its
+   own.
+
    See [IA32-v3a] 6.2.1 "Task-State Segment (TSS)" for a
    description of the TSS.  See [IA32-v3a] 5.12.1 "Exception- or
    Interrupt-Handler Procedures" for a description of when and
@@ -72,35 +76,42 @@ struct tss
     uint16_t trace, bitmap;
   };
 
-/* Kernel TSS. */
+/* Kernel TSSes, one per CPU, all in one page. */
 static struct tss *tss;
 
-/* Initializes the kernel TSS. */
+/* Initializes the kernel TSSes. */
 void
 tss_init (void) 
 {
+  unsigned i;
+
   /* Our TSS is never used in a call gate or task gate, so only a
      few fields of it are ever referenced, and those are the only
      ones we initialize. */
+  ASSERT (sizeof *tss * CPU_MAX <= PGSIZE);
   tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
-  tss->ss0 = SEL_KDSEG;
-  tss->bitmap = 0xdfff;
+  for (i = 0; i < CPU_MAX; i++) 
+    {
+      tss[i].ss0 = SEL_KDSEG;
+      tss[i].bitmap = 0xdfff;
+    }
   tss_update ();
 }
 
-/* Returns the kernel TSS. */
+/* Returns the kernel TSS of CPU. */
 struct tss *
-tss_get (void) 
+tss_get (unsigned cpu) 
 {
   ASSERT (tss != NULL);
-  return tss;
+  ASSERT (cpu < CPU_MAX);
+  return &tss[cpu];
 }
 
-/* Sets the ring 0 stack pointer in the TSS to point to the end
-   of the thread stack. */
+/* Sets the ring 0 stack pointer in the running CPU's TSS to
+   point to the end of the thread stack. */
 void
 tss_update (void) 
 {
   ASSERT (tss != NULL);
-  tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  tss[cpu_id ()].esp0 = (uint8_t *) thread_current () + PGSIZE;
 }
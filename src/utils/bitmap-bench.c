@@ -0,0 +1,313 @@
+/* Host-side micro-benchmark for lib/kernel/bitmap.c.
+
+   Builds the kernel's bitmap code for the host and times its
+   range operations against the bit-at-a-time algorithms they
+   replaced, on a bitmap the size of the free map of a 100 MB
+   disk.  Before timing anything, checks that both give the same
+   answers on random bitmaps.
+
+   Build with "make bitmap-bench" in this directory. */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+void hex_dump (uintptr_t ofs, const void *, size_t size, bool ascii);
+
+#include "../lib/kernel/bitmap.c"
+
+/* Sectors in a 100 MB disk. */
+#define BIT_CNT (100 * 1024 * 1024 / 512)
+
+/* Bit-at-a-time versions of the range operations. */
+
+static bool
+slow_contains (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) == value)
+      return true;
+  return false;
+}
+
+static size_t
+slow_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, value_cnt = 0;
+
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) == value)
+      value_cnt++;
+  return value_cnt;
+}
+
+static void
+slow_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    bitmap_set (b, start + i, value);
+}
+
+static size_t
+slow_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  if (cnt <= b->bit_cnt)
+    {
+      size_t last = b->bit_cnt - cnt;
+      size_t i;
+      for (i = start; i <= last; i++)
+        if (!slow_contains (b, i, cnt, !value))
+          return i;
+    }
+  return BITMAP_ERROR;
+}
+
+static size_t
+slow_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t idx = slow_scan (b, start, cnt, value);
+  if (idx != BITMAP_ERROR)
+    slow_set_multiple (b, idx, cnt, !value);
+  return idx;
+}
+
+/* Support. */
+
+void
+debug_panic (const char *file, int line, const char *function,
+             const char *message, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "%s:%d: %s(): ", file, line, function);
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+  fputc ('\n', stderr);
+  abort ();
+}
+
+void
+hex_dump (uintptr_t ofs, const void *buf, size_t size, bool ascii)
+{
+  const unsigned char *p = buf;
+  size_t i;
+
+  (void) ascii;
+  for (i = 0; i < size; i++)
+    printf ("%s%02x", i % 16 ? " " : i ? "\n" : "", p[i]);
+  printf ("  (at %#lx)\n", (unsigned long) ofs);
+}
+
+/* Returns a random number between 0 and N - 1. */
+static size_t
+random_below (size_t n)
+{
+  return ((size_t) rand () * RAND_MAX + rand ()) % n;
+}
+
+/* Sets each bit of B to true with probability PERMILLE / 1000. */
+static void
+fill_random (struct bitmap *b, int permille)
+{
+  size_t i;
+
+  for (i = 0; i < bitmap_size (b); i++)
+    bitmap_set (b, i, rand () % 1000 < permille);
+}
+
+/* Dies with a message about a mismatch in OPERATION. */
+static void
+mismatch (const char *operation, size_t start, size_t cnt, bool value)
+{
+  fprintf (stderr, "bitmap-bench: %s (%zu, %zu, %d) is wrong\n",
+           operation, start, cnt, value);
+  exit (EXIT_FAILURE);
+}
+
+/* Checks the range operations against the slow versions. */
+static void
+check (void)
+{
+  int trial;
+
+  for (trial = 0; trial < 200; trial++)
+    {
+      size_t bit_cnt = random_below (300);
+      struct bitmap *b = bitmap_create (bit_cnt);
+      struct bitmap *slow = bitmap_create (bit_cnt);
+      int op;
+
+      fill_random (b, random_below (1001));
+      for (op = 0; op < 1000; op++)
+        {
+          size_t start = random_below (bit_cnt + 1);
+          size_t cnt = random_below (bit_cnt - start + 1);
+          bool value = rand () % 2;
+          size_t i;
+
+          for (i = 0; i < bit_cnt; i++)
+            bitmap_set (slow, i, bitmap_test (b, i));
+
+          if (bitmap_contains (b, start, cnt, value)
+              != slow_contains (b, start, cnt, value))
+            mismatch ("bitmap_contains", start, cnt, value);
+          if (bitmap_count (b, start, cnt, value)
+              != slow_count (b, start, cnt, value))
+            mismatch ("bitmap_count", start, cnt, value);
+          if (bitmap_scan (b, start, cnt % 20, value)
+              != slow_scan (b, start, cnt % 20, value))
+            mismatch ("bitmap_scan", start, cnt % 20, value);
+
+          switch (rand () % 3)
+            {
+            case 0:
+              bitmap_set_multiple (b, start, cnt, value);
+              slow_set_multiple (slow, start, cnt, value);
+              break;
+            case 1:
+              if (bitmap_scan_and_flip (b, start, cnt % 20, value)
+                  != slow_scan_and_flip (slow, start, cnt % 20, value))
+                mismatch ("bitmap_scan_and_flip", start, cnt % 20, value);
+              break;
+            default:
+              if (start < bit_cnt)
+                {
+                  bitmap_flip (b, start);
+                  bitmap_flip (slow, start);
+                }
+              break;
+            }
+          for (i = 0; i < bit_cnt; i++)
+            if (bitmap_test (b, i) != bitmap_test (slow, i))
+              mismatch ("bitmap_set_multiple", start, cnt, value);
+        }
+      bitmap_destroy (b);
+      bitmap_destroy (slow);
+    }
+  printf ("Range operations agree with bit-at-a-time versions.\n");
+}
+
+/* Returns the current time in nanoseconds. */
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Prints the time per call of SLOW and FAST, each of which makes
+   ITER_CNT calls, under the given NAME. */
+static void
+report (const char *name, int iter_cnt, double slow, double fast)
+{
+  printf ("%-36s %12.0f %12.0f %8.1fx\n",
+          name, slow / iter_cnt, fast / iter_cnt, slow / fast);
+}
+
+/* A free map of a 100 MB disk that is 99% full, with the free
+   sectors scattered at random, except that the first half is
+   completely full. */
+static struct bitmap *
+nearly_full (void)
+{
+  struct bitmap *b = bitmap_create (BIT_CNT);
+
+  fill_random (b, 990);
+  bitmap_set_multiple (b, 0, BIT_CNT / 2, true);
+  return b;
+}
+
+int
+main (void)
+{
+  static const size_t scan_cnts[] = {1, 8, 64};
+  struct bitmap *b;
+  double t0, t1, t2, t3;
+  volatile size_t sink = 0;
+  char name[64];
+  size_t i;
+  int j;
+
+  srand (1);
+  check ();
+
+  printf ("\n%zu bits, ns per call:\n", (size_t) BIT_CNT);
+  printf ("%-36s %12s %12s %9s\n",
+          "operation", "bit-at-a-time", "word", "speedup");
+
+  b = nearly_full ();
+  for (i = 0; i < sizeof scan_cnts / sizeof *scan_cnts; i++)
+    {
+      const int iter_cnt = 20;
+      size_t cnt = scan_cnts[i];
+
+      t0 = now ();
+      for (j = 0; j < iter_cnt; j++)
+        sink += slow_scan (b, 0, cnt, false);
+      t1 = now ();
+      for (j = 0; j < iter_cnt; j++)
+        sink += bitmap_scan (b, 0, cnt, false);
+      t2 = now ();
+      snprintf (name, sizeof name, "scan for %zu free, 99%% full", cnt);
+      report (name, iter_cnt, t1 - t0, t2 - t1);
+    }
+
+  t0 = now ();
+  for (j = 0; j < 20; j++)
+    sink += slow_count (b, 0, BIT_CNT, false);
+  t1 = now ();
+  for (j = 0; j < 20; j++)
+    sink += bitmap_count (b, 0, BIT_CNT, false);
+  t2 = now ();
+  report ("count whole map", 20, t1 - t0, t2 - t1);
+
+  t0 = now ();
+  for (j = 0; j < 20; j++)
+    sink += slow_contains (b, 0, BIT_CNT / 2, false);
+  t1 = now ();
+  for (j = 0; j < 20; j++)
+    sink += bitmap_contains (b, 0, BIT_CNT / 2, false);
+  t2 = now ();
+  report ("contains over full half", 20, t1 - t0, t2 - t1);
+
+  t0 = now ();
+  for (j = 0; j < 1000; j++)
+    slow_set_multiple (b, 1000 + j, 4096, j % 2);
+  t1 = now ();
+  for (j = 0; j < 1000; j++)
+    bitmap_set_multiple (b, 1000 + j, 4096, j % 2);
+  t2 = now ();
+  report ("set 4096 bits", 1000, t1 - t0, t2 - t1);
+  bitmap_destroy (b);
+
+  /* Allocate sectors one at a time, as the free map does, from
+     two copies of the same map. */
+  srand (2);
+  b = nearly_full ();
+  t0 = now ();
+  for (j = 0; j < 500; j++)
+    sink += slow_scan_and_flip (b, 0, 1, false);
+  t1 = now ();
+  bitmap_destroy (b);
+  srand (2);
+  b = nearly_full ();
+  t2 = now ();
+  for (j = 0; j < 500; j++)
+    sink += bitmap_scan_and_flip (b, 0, 1, false);
+  t3 = now ();
+  report ("allocate 1 sector, 99% full", 500, t1 - t0, t3 - t2);
+  bitmap_destroy (b);
+
+  return EXIT_SUCCESS;
+}
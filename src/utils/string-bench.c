@@ -0,0 +1,264 @@
+/* Host-side micro-benchmark for lib/string.c.
+
+   Builds the Pintos string functions for the host, under names
+   that do not clash with the C library's, and times memcpy(),
+   memset(), memcmp() and strlen() against the byte-at-a-time
+   loops they replaced, for blocks of various sizes and
+   alignments.  Before timing anything, checks that both give the
+   same answers.
+
+   Build with "make string-bench" in this directory.  It is
+   compiled with -O, like the kernel, so that the compiler does
+   not vectorize the byte-at-a-time loops. */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define memcpy pintos_memcpy
+#define memmove pintos_memmove
+#define memcmp pintos_memcmp
+#define strcmp pintos_strcmp
+#define memchr pintos_memchr
+#define strchr pintos_strchr
+#define strcspn pintos_strcspn
+#define strpbrk pintos_strpbrk
+#define strrchr pintos_strrchr
+#define strspn pintos_strspn
+#define strstr pintos_strstr
+#define strtok_r pintos_strtok_r
+#define memset pintos_memset
+#define strlen pintos_strlen
+#define strnlen pintos_strnlen
+#define strlcpy pintos_strlcpy
+#define strlcat pintos_strlcat
+#include "../lib/string.c"
+#undef memcpy
+#undef memcmp
+#undef memset
+#undef strlen
+
+/* Biggest block to check or time. */
+#define MAX_SIZE 8192
+
+/* Byte-at-a-time versions. */
+
+static void *
+slow_memcpy (void *dst_, const void *src_, size_t size) 
+{
+  unsigned char *dst = dst_;
+  const unsigned char *src = src_;
+
+  while (size-- > 0)
+    *dst++ = *src++;
+  return dst_;
+}
+
+static void *
+slow_memset (void *dst_, int value, size_t size) 
+{
+  unsigned char *dst = dst_;
+
+  while (size-- > 0)
+    *dst++ = value;
+  return dst_;
+}
+
+static int
+slow_memcmp (const void *a_, const void *b_, size_t size) 
+{
+  const unsigned char *a = a_;
+  const unsigned char *b = b_;
+
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
+
+static size_t
+slow_strlen (const char *string) 
+{
+  const char *p;
+
+  for (p = string; *p != '\0'; p++)
+    continue;
+  return p - string;
+}
+
+/* Support. */
+
+void
+debug_panic (const char *file, int line, const char *function,
+             const char *message, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "%s:%d: %s(): ", file, line, function);
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+  fputc ('\n', stderr);
+  abort ();
+}
+
+/* Dies with a message about a mismatch in OPERATION. */
+static void
+mismatch (const char *operation, size_t size, int align)
+{
+  fprintf (stderr, "string-bench: %s (size %zu, alignment %d) is wrong\n",
+           operation, size, align);
+  exit (EXIT_FAILURE);
+}
+
+/* Fills the SIZE bytes at P with random nonzero bytes. */
+static void
+fill_random (unsigned char *p, size_t size)
+{
+  while (size-- > 0)
+    *p++ = rand () % 255 + 1;
+}
+
+/* Returns -1, 0, or 1 according to the sign of X. */
+static int
+sign (int x)
+{
+  return (x > 0) - (x < 0);
+}
+
+static unsigned char buf_a[MAX_SIZE + 64], buf_b[MAX_SIZE + 64];
+static unsigned char buf_c[MAX_SIZE + 64];
+
+/* Checks the fast functions against the slow ones. */
+static void
+check (void)
+{
+  int trial;
+
+  for (trial = 0; trial < 100000; trial++)
+    {
+      size_t size = rand () % (trial < 90000 ? 300 : MAX_SIZE);
+      int dst_align = rand () % 8, src_align = rand () % 8;
+      unsigned char *dst = buf_a + 16 + dst_align;
+      unsigned char *src = buf_b + 16 + src_align;
+      int value = rand () % 256;
+      size_t i;
+
+      /* memcpy() must copy exactly SIZE bytes. */
+      fill_random (buf_a, sizeof buf_a);
+      fill_random (buf_b, sizeof buf_b);
+      slow_memcpy (buf_c, buf_a, sizeof buf_a);
+      if (pintos_memcpy (dst, src, size) != dst)
+        mismatch ("memcpy return value", size, dst_align);
+      slow_memcpy (buf_c + 16 + dst_align, src, size);
+      if (slow_memcmp (buf_a, buf_c, sizeof buf_a))
+        mismatch ("memcpy", size, dst_align);
+
+      /* memset() must set exactly SIZE bytes. */
+      if (pintos_memset (dst, value, size) != dst)
+        mismatch ("memset return value", size, dst_align);
+      slow_memset (buf_c + 16 + dst_align, value, size);
+      if (slow_memcmp (buf_a, buf_c, sizeof buf_a))
+        mismatch ("memset", size, dst_align);
+
+      /* memcmp() on equal blocks, then with one differing byte. */
+      slow_memcpy (dst, src, size);
+      if (pintos_memcmp (dst, src, size) != 0)
+        mismatch ("memcmp on equal blocks", size, dst_align);
+      if (size > 0)
+        {
+          i = rand () % size;
+          dst[i] = rand () % 256;
+          if (sign (pintos_memcmp (dst, src, size))
+              != slow_memcmp (dst, src, size))
+            mismatch ("memcmp", size, dst_align);
+        }
+
+      /* strlen() of a string that ends SIZE bytes in. */
+      fill_random (src, size + 1);
+      src[size] = '\0';
+      if (pintos_strlen ((char *) src) != size)
+        mismatch ("strlen", size, src_align);
+    }
+  printf ("Fast versions agree with byte-at-a-time versions.\n");
+}
+
+/* Returns the current time in nanoseconds. */
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Prints the time per call of SLOW and FAST, each of which makes
+   ITER_CNT calls, under the given NAME. */
+static void
+report (const char *name, size_t size, int align, int iter_cnt,
+        double slow, double fast)
+{
+  printf ("%-8s %6zu %6d %12.1f %12.1f %8.1fx\n", name, size, align,
+          slow / iter_cnt, fast / iter_cnt, slow / fast);
+}
+
+/* Times SLOW_CALL and FAST_CALL, which are statements that
+   operate on SIZE bytes at alignment ALIGN, for function NAME. */
+#define TIME(NAME, SLOW_CALL, FAST_CALL)                        \
+        do {                                                    \
+          int iter_cnt = 20000000 / (size + 16);                \
+          double t0, t1, t2;                                    \
+          int j;                                                \
+                                                                \
+          t0 = now ();                                          \
+          for (j = 0; j < iter_cnt; j++)                        \
+            SLOW_CALL;                                          \
+          t1 = now ();                                          \
+          for (j = 0; j < iter_cnt; j++)                        \
+            FAST_CALL;                                          \
+          t2 = now ();                                          \
+          report (NAME, size, align, iter_cnt, t1 - t0, t2 - t1); \
+        } while (0)
+
+int
+main (void)
+{
+  static const size_t sizes[] = {8, 64, 512, 4096};
+  static const int aligns[] = {0, 3};
+  volatile size_t sink = 0;
+  size_t i, k;
+
+  srand (1);
+  check ();
+
+  printf ("\nns per call:\n");
+  printf ("%-8s %6s %6s %12s %12s %9s\n",
+          "function", "size", "align", "byte-at-a-time", "fast", "speedup");
+  for (k = 0; k < sizeof aligns / sizeof *aligns; k++)
+    for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+      {
+        size_t size = sizes[i];
+        int align = aligns[k];
+        unsigned char *dst = buf_a + 16 + align;
+        unsigned char *src = buf_b + 16;
+
+        TIME ("memcpy", slow_memcpy (dst, src, size),
+              pintos_memcpy (dst, src, size));
+        TIME ("memset", slow_memset (dst, align, size),
+              pintos_memset (dst, align, size));
+        slow_memcpy (dst, src, size);
+        TIME ("memcmp", sink += slow_memcmp (dst, src, size),
+              sink += pintos_memcmp (dst, src, size));
+        fill_random (dst, size);
+        dst[size] = '\0';
+        TIME ("strlen", sink += slow_strlen ((char *) dst),
+              sink += pintos_strlen ((char *) dst));
+      }
+
+  return EXIT_SUCCESS;
+}